@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include "RpnEnvironment.h"
+#include "RpnInstruction.h"
+
+// Shared by the host benchmarks in this directory. Each one includes this from its own
+// directory, so the build lines only need -Isource for the sources.
+
+typedef RpnEnvironment E;
+typedef RpnInstruction I;
+
+// Average time of one call of func over rounds calls, in microseconds
+template <typename _Func>
+static double TimePerRound(int rounds, _Func func)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; r++) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+}
+
+// Values that differ between a and b; two values that are both undefined (NaN or infinite)
+// count as the same
+static inline int Mismatches(const float *a, const float *b, std::size_t count)
+{
+	int mismatches = 0;
+	for (std::size_t i=0; i<count; i++) {
+		bool same = (a[i] == b[i]) || (!std::isfinite(a[i]) && !std::isfinite(b[i]));
+		if (!same) ++mismatches;
+	}
+	return mismatches;
+}
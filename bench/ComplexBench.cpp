@@ -0,0 +1,106 @@
+// Checks RpnComplex against std::complex<double> over a grid of z for each function, then
+// times a heatmap tile's worth of samples with RpnComplex, which runs each instruction over a
+// block of lanes with the real and imaginary parts in separate arrays, against a loop calling
+// the std::complex reference for one sample at a time. Also checks that negative reals reached by
+// negation, whose imaginary part is -0, get the same principal values as the ones typed in.
+// Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/ComplexBench.cpp source/RpnComplex.cpp source/RpnInstruction.cpp source/RpnEnvironment.cpp source/NumberFormat.cpp -o complexbench
+//
+// and prints the mismatches and the time per block for each function.
+
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+#include "Bench.h"
+#include "RpnComplex.h"
+#include "RpnInstruction.h"
+
+typedef std::complex<double> Complex;
+
+static const int side = 64; // samples along each side of the grid
+
+static bool Close(float re, float im, Complex expected)
+{
+	float tolerance = 1e-4f * (float)std::max(1.0, std::abs(expected));
+	return std::abs(re - (float)expected.real()) <= tolerance && std::abs(im - (float)expected.imag()) <= tolerance;
+}
+
+int main()
+{
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> program;
+		Complex (*reference)(Complex);
+	} cases[] = {
+		{"x sqrt", {I(E::VAR_X), I(std::sqrt, "sqrt", ~I::D_NEGATIVE)}, [](Complex z) { return std::sqrt(z); }},
+		{"x ln", {I(E::VAR_X), I(std::log, "ln", I::D_POSITIVE)}, [](Complex z) { return std::log(z); }},
+		{"x exp", {I(E::VAR_X), I(std::exp, "exp")}, [](Complex z) { return std::exp(z); }},
+		{"x sin", {I(E::VAR_X), I(std::sin, "sin")}, [](Complex z) { return std::sin(z); }},
+		{"x asin", {I(E::VAR_X), I(std::asin, "asin")}, [](Complex z) { return std::asin(z); }},
+		{"x atan", {I(E::VAR_X), I(std::atan, "atan")}, [](Complex z) { return std::atan(z); }},
+		{"x 2.5 ^", {I(E::VAR_X), I(2.5f), I(I::OP_POWER)}, [](Complex z) { return std::pow(z, 2.5); }},
+		{"1 x x * 1 + /", {I(1.0f), I(E::VAR_X), I(E::VAR_X), I(I::OP_MULTIPLY), I(1.0f), I(I::OP_ADD), I(I::OP_DIVIDE)}, [](Complex z) { return 1.0 / (z * z + 1.0); }},
+	};
+	
+	// Half a step off the axes, so no sample lies on a branch cut
+	const int count = side * side;
+	std::vector<float> xs(count), ys(count), re(count), im(count);
+	for (int j=0; j<side; j++) {
+		for (int i=0; i<side; i++) {
+			xs[j * side + i] = -3.0f + 6.0f * (i + 0.5f) / side;
+			ys[j * side + i] = -3.0f + 6.0f * (j + 0.5f) / side;
+		}
+	}
+	
+	RpnEnvironment env;
+	RpnComplex complex;
+	const float *laneRe[E::SLOT_COUNT] = {}, *laneIm[E::SLOT_COUNT] = {};
+	laneRe[E::VAR_X] = &xs[0];
+	laneIm[E::VAR_X] = &ys[0];
+	
+	const int rounds = 50;
+	for (auto &c : cases) {
+		complex.Compile(c.program);
+		complex.Evaluate(env, laneRe, laneIm, count, &re[0], &im[0]);
+		int mismatches = 0;
+		for (int k=0; k<count; k++) {
+			if (!Close(re[k], im[k], c.reference(Complex(xs[k], ys[k])))) ++mismatches;
+		}
+		
+		double scalar = TimePerRound(rounds, [&]() {
+			for (int k=0; k<count; k++) {
+				Complex z = c.reference(Complex(xs[k], ys[k]));
+				re[k] = z.real();
+				im[k] = z.imag();
+			}
+		});
+		double batched = TimePerRound(rounds, [&]() { complex.Evaluate(env, laneRe, laneIm, count, &re[0], &im[0]); });
+		std::printf("%-16s %8.1f -> %7.1f us/%d samples, %d mismatches\n", c.text, scalar, batched, count, mismatches);
+	}
+	
+	// sqrt and ln of -4 typed in and of 4 negated; both are on the upper side of the cut
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> program;
+		Complex expected;
+	} cuts[] = {
+		{"-4 sqrt", {I(-4.0f), I(std::sqrt, "sqrt", ~I::D_NEGATIVE)}, Complex(0, 2)},
+		{"4 neg sqrt", {I(4.0f), I(I::OP_NEGATE), I(std::sqrt, "sqrt", ~I::D_NEGATIVE)}, Complex(0, 2)},
+		{"-4 ln", {I(-4.0f), I(std::log, "ln", I::D_POSITIVE)}, Complex(std::log(4.0), M_PI)},
+		{"4 neg ln", {I(4.0f), I(I::OP_NEGATE), I(std::log, "ln", I::D_POSITIVE)}, Complex(std::log(4.0), M_PI)},
+		{"4 neg 0.5 ^", {I(4.0f), I(I::OP_NEGATE), I(0.5f), I(I::OP_POWER)}, Complex(0, 2)},
+	};
+	int failures = 0;
+	for (auto &c : cuts) {
+		float r, m;
+		complex.Compile(c.program);
+		complex.Evaluate(env, nullptr, nullptr, 1, &r, &m);
+		bool ok = Close(r, m, c.expected);
+		failures += ok ? 0 : 1;
+		std::printf("%-16s %g%+gi %s\n", c.text, r, m, ok ? "ok" : "WRONG");
+	}
+	
+	return failures;
+}
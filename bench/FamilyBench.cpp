@@ -0,0 +1,93 @@
+// Times drawing a family of curves (one equation for N values of a slider) by running
+// ExecuteRpn for every column and value, against HoistInvariants + HoistColumnWork + RpnBatch,
+// which compute the x-only work once per column and share it. Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/FamilyBench.cpp source/RpnInstruction.cpp source/RpnBatch.cpp source/RpnEnvironment.cpp source/NumberFormat.cpp -o familybench
+//
+// and prints the time per frame for each equation, after checking both give the same results.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Bench.h"
+#include "RpnBatch.h"
+#include "RpnInstruction.h"
+
+static const int columns = 400;
+static const int familyCount = 16;
+
+static void FamilyScalar(const std::vector<RpnInstruction> &equation, RpnEnvironment env, const float *xs, float *out)
+{
+	for (int p=0; p<familyCount; p++) {
+		env[E::VAR_A] = p / (float)(familyCount - 1);
+		for (int x=0; x<columns; x++) {
+			env[E::VAR_X] = xs[x];
+			float y;
+			out[p * columns + x] = (ExecuteRpn(equation, env, y) == I::S_OK) ? y : NAN;
+		}
+	}
+}
+
+static void FamilyBatched(const std::vector<RpnInstruction> &equation, RpnEnvironment env, const float *xs, float *out)
+{
+	static std::vector<RpnInstruction> folded, outer;
+	static std::vector<std::vector<RpnInstruction>> temps;
+	static std::vector<float> tempValues;
+	static RpnBatch batch;
+	
+	const unsigned xSlot = 1u << E::VAR_X;
+	HoistInvariants(equation, env, xSlot | (1u << E::VAR_A), folded);
+	HoistColumnWork(folded, xSlot, E::TEMP_FIRST, outer, temps);
+	
+	const float *lanes[E::SLOT_COUNT] = {};
+	lanes[E::VAR_X] = xs;
+	tempValues.resize(temps.size() * columns);
+	for (std::size_t k=0; k<temps.size(); k++) {
+		batch.Compile(temps[k]);
+		batch.Evaluate(env, lanes, columns, &tempValues[k * columns]);
+	}
+	for (std::size_t k=0; k<temps.size(); k++) {
+		lanes[E::TEMP_FIRST + k] = &tempValues[k * columns];
+	}
+	
+	batch.Compile(outer);
+	for (int p=0; p<familyCount; p++) {
+		env[E::VAR_A] = p / (float)(familyCount - 1);
+		batch.Evaluate(env, lanes, columns, out + p * columns);
+	}
+}
+
+int main()
+{
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> equation;
+	} cases[] = {
+		{"a x sin *", {I(E::VAR_A), I(E::VAR_X), I(std::sin, "sin"), I(I::OP_MULTIPLY)}},
+		{"x 2 ^ sin x cos * a * x exp b / +", {I(E::VAR_X), I(2.0f), I(I::OP_POWER), I(std::sin, "sin"), I(E::VAR_X), I(std::cos, "cos"), I(I::OP_MULTIPLY), I(E::VAR_A), I(I::OP_MULTIPLY), I(E::VAR_X), I(std::exp, "exp"), I(E::VAR_B), I(I::OP_DIVIDE), I(I::OP_ADD)}},
+		{"x a * sin", {I(E::VAR_X), I(E::VAR_A), I(I::OP_MULTIPLY), I(std::sin, "sin")}},
+		{"x ln a ^", {I(E::VAR_X), I(std::log, "ln", I::D_POSITIVE), I(E::VAR_A), I(I::OP_POWER)}},
+	};
+	
+	RpnEnvironment env;
+	env[E::VAR_B] = 0.7f;
+	
+	std::vector<float> xs(columns), scalar(columns * familyCount), batched(columns * familyCount);
+	for (int x=0; x<columns; x++) {
+		xs[x] = -5.0f + x * (10.0f / (columns - 1));
+	}
+	
+	const int rounds = 200;
+	for (auto &c : cases) {
+		FamilyScalar(c.equation, env, &xs[0], &scalar[0]);
+		FamilyBatched(c.equation, env, &xs[0], &batched[0]);
+		
+		int mismatches = Mismatches(&scalar[0], &batched[0], scalar.size());
+		
+		double before = TimePerRound(rounds, [&]() { FamilyScalar(c.equation, env, &xs[0], &scalar[0]); });
+		double after = TimePerRound(rounds, [&]() { FamilyBatched(c.equation, env, &xs[0], &batched[0]); });
+		std::printf("%-36s N=%d: %8.1f -> %7.1f us/frame, %d mismatches\n", c.text, familyCount, before, after, mismatches);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,126 @@
+// Compares the allocation-free number formatting in NumberFormat.cpp with the ssprintf path
+// the slider and trace readouts used before, as it was then and as Common.cpp has it now.
+// Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/FormatBench.cpp source/NumberFormat.cpp -o formatbench
+//
+// and prints the time per call for each method.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "NumberFormat.h"
+
+// vssprintf as the readouts used it before: sized with one pass, formatted into a new[] buffer
+// and copied into the string. It passed the same va_list to both passes, which works on the 3DS,
+// where va_list is passed by value, but not on x86-64, so the second pass gets a copy here.
+static std::string LegacyVssprintf(const char *format, va_list arg)
+{
+	va_list argCopy;
+	va_copy(argCopy, arg);
+	int size = vsnprintf(nullptr, 0, format, arg);
+	char *buf = new char[size + 1];
+	vsnprintf(buf, size + 1, format, argCopy);
+	std::string str = buf;
+	delete[] buf;
+	va_end(argCopy);
+	return str;
+}
+
+static std::string LegacySsprintf(const char *format, ...)
+{
+	va_list vl;
+	va_start(vl, format);
+	std::string str = LegacyVssprintf(format, vl);
+	va_end(vl);
+	return str;
+}
+
+// Same as vssprintf/ssprintf in Common.cpp now, which can't be built here because Common.h
+// pulls in sf2d.h
+static std::string vssprintf(const char *format, va_list arg)
+{
+	va_list argCopy;
+	va_copy(argCopy, arg);
+	int size = vsnprintf(nullptr, 0, format, argCopy);
+	va_end(argCopy);
+	
+	std::string str(size, '\0');
+	vsnprintf(&str[0], size + 1, format, arg);
+	return str;
+}
+
+static std::string ssprintf(const char *format, ...)
+{
+	va_list vl;
+	va_start(vl, format);
+	std::string str = vssprintf(format, vl);
+	va_end(vl);
+	return str;
+}
+
+// In nanoseconds
+template <typename _Func>
+static double TimePerCall(const std::vector<float> &values, int rounds, _Func func)
+{
+	double us = TimePerRound(rounds, [&]() {
+		for (float value : values) {
+			func(value);
+		}
+	});
+	return us * 1000.0 / values.size();
+}
+
+int main()
+{
+	std::vector<float> values;
+	std::srand(1);
+	for (int i=0; i<10000; i++) {
+		values.push_back((std::rand() / (float)RAND_MAX - 0.5f) * 20.0f);
+	}
+	
+	// Make sure the paths agree before timing them.
+	char buf[64];
+	for (float value : values) {
+		FormatFixed(buf, sizeof(buf), value, 5);
+		if (ssprintf("%.5f", value) != buf || LegacySsprintf("%.5f", value) != buf) {
+			std::printf("mismatch for %.9g: %s vs %s\n", value, ssprintf("%.5f", value).c_str(), buf);
+			return 1;
+		}
+	}
+	
+	const int rounds = 100;
+	std::size_t sink = 0;
+	
+	double legacyFixed = TimePerCall(values, rounds, [&](float value) {
+		sink += LegacySsprintf("%.5f", value).size();
+	});
+	double currentFixed = TimePerCall(values, rounds, [&](float value) {
+		sink += ssprintf("%.5f", value).size();
+	});
+	double fixed = TimePerCall(values, rounds, [&](float value) {
+		sink += FormatFixed(buf, sizeof(buf), value, 5);
+	});
+	double legacyShortest = TimePerCall(values, rounds, [&](float value) {
+		std::ostringstream ss;
+		ss << value;
+		sink += ss.str().size();
+	});
+	double shortest = TimePerCall(values, rounds, [&](float value) {
+		sink += FormatShortest(buf, sizeof(buf), value);
+	});
+	
+	std::printf("ssprintf(\"%%.5f\"), before %8.1f ns/call\n", legacyFixed);
+	std::printf("ssprintf(\"%%.5f\"), now    %8.1f ns/call  (%.1fx)\n", currentFixed, legacyFixed / currentFixed);
+	std::printf("FormatFixed(5)           %8.1f ns/call  (%.1fx)\n", fixed, legacyFixed / fixed);
+	std::printf("ostringstream <<         %8.1f ns/call\n", legacyShortest);
+	std::printf("FormatShortest           %8.1f ns/call  (%.1fx)\n", shortest, legacyShortest / shortest);
+	std::printf("(checksum %zu)\n", sink);
+	
+	return 0;
+}
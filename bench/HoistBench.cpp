@@ -0,0 +1,70 @@
+// Compares evaluating equations over 400 columns as typed with evaluating them after
+// HoistInvariants has folded everything that doesn't depend on x. Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/HoistBench.cpp source/RpnInstruction.cpp source/RpnEnvironment.cpp source/NumberFormat.cpp -o hoistbench
+//
+// and prints the time per frame for each equation, after checking both give the same results.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Bench.h"
+#include "RpnInstruction.h"
+
+// One frame of a function plot, adding up the values so they can't be optimized away
+static void Plot(const std::vector<RpnInstruction> &equation, RpnEnvironment &env, float &sum)
+{
+	for (int x=0; x<400; x++) {
+		env[E::VAR_X] = -5.0f + x * (10.0f / 399.0f);
+		float y;
+		if (ExecuteRpn(equation, env, y) == I::S_OK) {
+			sum += y;
+		}
+	}
+}
+
+int main()
+{
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> equation;
+	} cases[] = {
+		{"x sin", {I(E::VAR_X), I(std::sin, "sin")}},
+		{"a 2 ^ b sqrt * x sin *", {I(E::VAR_A), I(2.0f), I(I::OP_POWER), I(E::VAR_B), I(std::sqrt, "sqrt", ~I::D_NEGATIVE), I(I::OP_MULTIPLY), I(E::VAR_X), I(std::sin, "sin"), I(I::OP_MULTIPLY)}},
+		{"a x * b + sin c d cos * exp *", {I(E::VAR_A), I(E::VAR_X), I(I::OP_MULTIPLY), I(E::VAR_B), I(I::OP_ADD), I(std::sin, "sin"), I(E::VAR_C), I(E::VAR_D), I(std::cos, "cos"), I(I::OP_MULTIPLY), I(std::exp, "exp"), I(I::OP_MULTIPLY)}},
+		{"a b c d + + + dup * a ln b ln + - x +", {I(E::VAR_A), I(E::VAR_B), I(E::VAR_C), I(E::VAR_D), I(I::OP_ADD), I(I::OP_ADD), I(I::OP_ADD), I(I::OP_DUP), I(I::OP_MULTIPLY), I(E::VAR_A), I(std::log, "ln", I::D_POSITIVE), I(E::VAR_B), I(std::log, "ln", I::D_POSITIVE), I(I::OP_ADD), I(I::OP_SUBTRACT), I(E::VAR_X), I(I::OP_ADD)}},
+		{"x a 0 / +", {I(E::VAR_X), I(E::VAR_A), I(0.0f), I(I::OP_DIVIDE), I(I::OP_ADD)}},
+	};
+	
+	RpnEnvironment env;
+	env[E::VAR_A] = 0.3f;
+	env[E::VAR_B] = 0.7f;
+	env[E::VAR_C] = 0.2f;
+	env[E::VAR_D] = 0.9f;
+	
+	const int rounds = 2000;
+	float sink = 0.0f;
+	
+	for (auto &c : cases) {
+		std::vector<RpnInstruction> hoisted;
+		HoistInvariants(c.equation, env, 1u << E::VAR_X, hoisted);
+		
+		int mismatches = 0;
+		for (int x=0; x<400; x++) {
+			env[E::VAR_X] = -5.0f + x * (10.0f / 399.0f);
+			float y1 = 0.0f, y2 = 0.0f;
+			I::Status s1 = ExecuteRpn(c.equation, env, y1);
+			I::Status s2 = ExecuteRpn(hoisted, env, y2);
+			if (s1 != s2 || (s1 == I::S_OK && y1 != y2)) {
+				++mismatches;
+			}
+		}
+		
+		double before = TimePerRound(rounds, [&]() { Plot(c.equation, env, sink); });
+		double after = TimePerRound(rounds, [&]() { Plot(hoisted, env, sink); });
+		std::printf("%-40s %2u -> %2u instructions, %7.1f -> %7.1f us/frame, %d mismatches\n",
+			c.text, (unsigned)c.equation.size(), (unsigned)hoisted.size(), before, after, mismatches);
+	}
+	
+	return sink == 12345.0f;
+}
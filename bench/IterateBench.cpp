@@ -0,0 +1,73 @@
+// Times one frame's worth of a bifurcation diagram (a map y -> f(x, y) iterated for every
+// column) with ExecuteRpn, which runs the whole program through a std::vector stack for every
+// column and iteration, against RpnBatch::Iterate, which runs each instruction over a block of
+// columns and keeps the block in place for all the iterations. Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/IterateBench.cpp source/RpnInstruction.cpp source/RpnBatch.cpp source/RpnEnvironment.cpp source/NumberFormat.cpp -o iteratebench
+//
+// and prints the time per frame for each map, after checking both give the same results.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Bench.h"
+#include "RpnBatch.h"
+#include "RpnInstruction.h"
+
+static const int columns = 400;
+static const int iterations = 64;
+
+static void IterateScalar(const std::vector<RpnInstruction> &map, RpnEnvironment env, const float *xs, float *state)
+{
+	for (int x=0; x<columns; x++) {
+		env[E::VAR_X] = xs[x];
+		for (int k=0; k<iterations; k++) {
+			env[E::VAR_Y] = state[x];
+			float y;
+			state[x] = (ExecuteRpn(map, env, y) == I::S_OK) ? y : NAN;
+		}
+	}
+}
+
+static void IterateBatched(const std::vector<RpnInstruction> &map, const RpnEnvironment &env, const float *xs, float *state)
+{
+	static RpnBatch batch;
+	batch.Compile(map);
+	const float *lanes[E::SLOT_COUNT] = {};
+	lanes[E::VAR_X] = xs;
+	batch.Iterate(env, lanes, columns, E::VAR_Y, state, iterations);
+}
+
+int main()
+{
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> map;
+	} cases[] = {
+		{"x y * 1 y - *", {I(E::VAR_X), I(E::VAR_Y), I(I::OP_MULTIPLY), I(1.0f), I(E::VAR_Y), I(I::OP_SUBTRACT), I(I::OP_MULTIPLY)}},
+		{"x y sin *", {I(E::VAR_X), I(E::VAR_Y), I(std::sin, "sin"), I(I::OP_MULTIPLY)}},
+		{"y 2 ^ x -", {I(E::VAR_Y), I(2.0f), I(I::OP_POWER), I(E::VAR_X), I(I::OP_SUBTRACT)}},
+	};
+
+	RpnEnvironment env;
+	std::vector<float> xs(columns), scalar(columns), batched(columns);
+	for (int x=0; x<columns; x++) {
+		xs[x] = 2.5f + x * (1.5f / (columns - 1));
+	}
+
+	const int rounds = 200;
+	for (auto &c : cases) {
+		scalar.assign(columns, 0.5f);
+		batched.assign(columns, 0.5f);
+		IterateScalar(c.map, env, &xs[0], &scalar[0]);
+		IterateBatched(c.map, env, &xs[0], &batched[0]);
+
+		int mismatches = Mismatches(&scalar[0], &batched[0], columns);
+
+		double before = TimePerRound(rounds, [&]() { IterateScalar(c.map, env, &xs[0], &scalar[0]); });
+		double after = TimePerRound(rounds, [&]() { IterateBatched(c.map, env, &xs[0], &batched[0]); });
+		std::printf("%-16s %d iterations: %8.1f -> %7.1f us/frame, %d mismatches\n", c.text, iterations, before, after, mismatches);
+	}
+
+	return 0;
+}
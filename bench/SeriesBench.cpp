@@ -0,0 +1,119 @@
+// Times a frame of 200-term series plots written out term by term against the same series
+// written as one OP_LOOP ... OP_SUM loop, both with ExecuteRpn and with RpnBatch. Written out,
+// every term costs its instructions again; as a loop, RpnBatch runs the body over a block of
+// columns for each k. Builds on the host:
+//
+//     g++ -O2 -std=gnu++11 -Isource bench/SeriesBench.cpp source/RpnInstruction.cpp source/RpnBatch.cpp source/RpnEnvironment.cpp source/NumberFormat.cpp -o seriesbench
+//
+// and prints the time per frame for each way, after checking they give the same results.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Bench.h"
+#include "RpnBatch.h"
+#include "RpnInstruction.h"
+
+static const int columns = 400;
+static const int terms = 200;
+
+// body(k) for k = 0 to terms - 1, added up in the same order as the loop
+template <typename _Body>
+static std::vector<RpnInstruction> WrittenOut(_Body body)
+{
+	std::vector<RpnInstruction> out;
+	for (int k=0; k<terms; k++) {
+		std::vector<RpnInstruction> term = body(I((float)k));
+		out.insert(out.end(), term.begin(), term.end());
+		if (k > 0) {
+			out.push_back(I(I::OP_ADD));
+		}
+	}
+	return out;
+}
+
+template <typename _Body>
+static std::vector<RpnInstruction> Loop(_Body body)
+{
+	std::vector<RpnInstruction> out = {I((float)terms), I(I::OP_LOOP)};
+	std::vector<RpnInstruction> term = body(I(E::VAR_K));
+	out.insert(out.end(), term.begin(), term.end());
+	out.push_back(I(I::OP_SUM));
+	return out;
+}
+
+static void PlotScalar(const std::vector<RpnInstruction> &equation, RpnEnvironment env, const float *xs, float *out)
+{
+	for (int x=0; x<columns; x++) {
+		env[E::VAR_X] = xs[x];
+		float y;
+		out[x] = (ExecuteRpn(equation, env, y) == I::S_OK) ? y : NAN;
+	}
+}
+
+static void PlotBatched(const std::vector<RpnInstruction> &equation, const RpnEnvironment &env, const float *xs, float *out)
+{
+	static RpnBatch batch;
+	batch.Compile(equation);
+	const float *lanes[E::SLOT_COUNT] = {};
+	lanes[E::VAR_X] = xs;
+	batch.Evaluate(env, lanes, columns, out);
+}
+
+int main()
+{
+	// Square wave: sin((2k + 1) x) / (2k + 1)
+	auto square = [](I k) {
+		return std::vector<RpnInstruction>{I(2.0f), k, I(I::OP_MULTIPLY), I(1.0f), I(I::OP_ADD), I(E::VAR_X), I(I::OP_MULTIPLY),
+			I(std::sin, "sin"), I(2.0f), k, I(I::OP_MULTIPLY), I(1.0f), I(I::OP_ADD), I(I::OP_DIVIDE)};
+	};
+	// Geometric series: (x / 4)^k
+	auto geometric = [](I k) {
+		return std::vector<RpnInstruction>{I(E::VAR_X), I(4.0f), I(I::OP_DIVIDE), k, I(I::OP_POWER)};
+	};
+
+	struct {
+		const char *text;
+		std::vector<RpnInstruction> writtenOut, loop;
+	} cases[] = {
+		{"square wave", WrittenOut(square), Loop(square)},
+		{"geometric", WrittenOut(geometric), Loop(geometric)},
+	};
+
+	RpnEnvironment env;
+	std::vector<float> xs(columns), reference(columns), out(columns);
+	for (int x=0; x<columns; x++) {
+		xs[x] = -5.0f + x * (10.0f / (columns - 1));
+	}
+
+	const int rounds = 20;
+	for (auto &c : cases) {
+		PlotScalar(c.writtenOut, env, &xs[0], &reference[0]);
+		std::printf("%s, %d terms (%d instructions written out, %d as a loop):\n", c.text, terms, (int)c.writtenOut.size(), (int)c.loop.size());
+
+		struct {
+			const char *name;
+			const std::vector<RpnInstruction> &equation;
+			bool batched;
+		} ways[] = {
+			{"written out, ExecuteRpn", c.writtenOut, false},
+			{"loop, ExecuteRpn", c.loop, false},
+			{"written out, RpnBatch", c.writtenOut, true},
+			{"loop, RpnBatch", c.loop, true},
+		};
+		for (auto &w : ways) {
+			auto plot = [&]() {
+				if (w.batched) {
+					PlotBatched(w.equation, env, &xs[0], &out[0]);
+				} else {
+					PlotScalar(w.equation, env, &xs[0], &out[0]);
+				}
+			};
+			plot();
+			int mismatches = Mismatches(&reference[0], &out[0], columns);
+			std::printf("  %-24s %8.1f us/frame, %d mismatches\n", w.name, TimePerRound(rounds, plot), mismatches);
+		}
+	}
+
+	return 0;
+}
@@ -10,12 +10,75 @@ The above copyright notice and this permission notice shall be included in all c
 THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <cstdio>
-#include <sstream>
+#include <cstring>
 #include "BmpFont.h"
+#include "GlyphBatch.h"
+
+GlyphBatch *BmpFont::batch = nullptr;
+
+TextLayout::TextLayout()
+{
+    invalidate();
+    wrapWidth = 0;
+    alignment = ALIGN_LEFT;
+    width = height = lines = 0;
+}
+
+void TextLayout::invalidate()
+{
+    font = nullptr;
+}
+
+u32 TextLayout::getWidth() const
+{
+    return width;
+}
+
+u32 TextLayout::getHeight() const
+{
+    return height;
+}
+
+u32 TextLayout::getLineCount() const
+{
+    return lines;
+}
+
+// Offset of a texel in the GPU's texture layout: bottom row first, in 8x8 tiles, with the
+// texels of each tile in Morton order. x and y are counted from the top left as usual.
+static u32 tiledOffset(u32 x, u32 y, u32 width, u32 height)
+{
+    u32 gy = height - 1 - y;
+    u32 morton = 0;
+    for (int bit=0; bit<3; ++bit) {
+        morton |= ((x >> bit) & 1) << (2*bit);
+        morton |= ((gy >> bit) & 1) << (2*bit + 1);
+    }
+    return ((gy >> 3) * (width >> 3) + (x >> 3)) * 64 + morton;
+}
+
+// Fills a TEXFMT_A4 texture (two texels per byte, low nibble first) from 8-bit alpha values.
+static void storeAlpha4(sf2d_texture *texture, const u8 *alpha, u32 width, u32 height)
+{
+    u8 *dst = (u8*)texture->data;
+    std::memset(dst, 0, texture->data_size);
+
+    for (u32 y=0; y<height; ++y) {
+        for (u32 x=0; x<width; ++x) {
+            u32 offset = tiledOffset(x, y, texture->pow2_w, texture->pow2_h);
+            u8 nibble = (alpha[y*width + x] * 15 + 127) / 255;
+            dst[offset / 2] |= (offset & 1) ? (nibble << 4) : nibble;
+        }
+    }
+
+    GSPGPU_FlushDataCache(dst, texture->data_size);
+}
 
 BmpFont::BmpFont()
 {
+    alignment = ALIGN_LEFT;
     unclip();
 }
 
@@ -25,11 +88,6 @@ BmpFont::BmpFont(const char *filename)
     load(filename);
 }
 
-BmpFont::FontData::~FontData()
-{
-    sf2d_free_texture(texture);
-}
-
 bool BmpFont::load(const char *filename)
 {
     data.reset(new FontData());
@@ -57,34 +115,50 @@ bool BmpFont::load(const char *filename)
         std::fread(&data->baseChar, 1, 1, fp);
         std::fread(data->charWidths, 1, 256, fp);
 
-        std::size_t byteCount = 4 * data->imgWidth * data->imgHeight;
-        u8 *texdata = new u8[byteCount];
+        std::size_t pixelCount = data->imgWidth * data->imgHeight;
+        bool ok = false;
 
         if (bitCount == 8) {
-            u8 *ptr = texdata;
-            for (std::size_t i=0; i<byteCount/4; ++i) {
-                ptr[0] = ptr[1] = ptr[2] = 0xFF;
-                std::fread(&ptr[3], 1, 1, fp);
-                ptr += 4;
+            // Single-channel fonts only have alpha, so they go into a 4-bit alpha texture, an
+            // eighth of the size of RGBA8. The color still comes from the blend color.
+            std::vector<u8> alpha(pixelCount);
+            if (std::fread(alpha.data(), 1, pixelCount, fp) == pixelCount) {
+                data->texture.reset(sf2d_create_texture(data->imgWidth, data->imgHeight, TEXFMT_A4, SF2D_PLACE_RAM), sf2d_free_texture);
+                ok = (bool)data->texture;
             }
-        } else if (bitCount == 24) {
-            u8 *ptr = texdata;
-            for (std::size_t i=0; i<byteCount/4; ++i) {
-                std::fread(ptr, 1, 3, fp);
-                ptr[3] = 0xFF;
-                ptr += 4;
+            if (ok)
+                storeAlpha4(data->texture.get(), alpha.data(), data->imgWidth, data->imgHeight);
+        } else if (bitCount == 24 || bitCount == 32) {
+            // The image is read in one go into the end of the RGBA8 buffer and then expanded in place,
+            // front to back. A pixel's destination never overlaps source bytes that haven't been read yet.
+            std::size_t byteCount = 4 * pixelCount;
+            std::size_t srcCount = pixelCount * (bitCount / 8);
+            u8 *texdata = new u8[byteCount];
+            u8 *src = texdata + (byteCount - srcCount);
+            ok = (std::fread(src, 1, srcCount, fp) == srcCount);
+
+            if (ok && bitCount == 24) {
+                for (std::size_t i=0; i<pixelCount; ++i) {
+                    u8 r = src[3*i], g = src[3*i+1], b = src[3*i+2];
+                    texdata[4*i] = r;
+                    texdata[4*i+1] = g;
+                    texdata[4*i+2] = b;
+                    texdata[4*i+3] = 0xFF;
+                }
             }
-        } else if (bitCount == 32) {
-            std::fread(texdata, 1, byteCount, fp);
-        } else {
+
+            if (ok)
+                data->texture.reset(sf2d_create_texture_mem_RGBA8(texdata, data->imgWidth, data->imgHeight, TEXFMT_RGBA8, SF2D_PLACE_RAM), sf2d_free_texture);
+            delete[] texdata;
+        }
+
+        if (!ok) {
             std::fclose(fp);
             data.reset();
             return false;
         }
 
-        data->texture = sf2d_create_texture_mem_RGBA8(texdata, data->imgWidth, data->imgHeight, TEXFMT_RGBA8, SF2D_PLACE_RAM);
-        delete[] texdata;
-
+        data->originX = data->originY = 0;
         std::fclose(fp);
 
         return true;
@@ -94,14 +168,111 @@ bool BmpFont::load(const char *filename)
     }
 }
 
+bool BmpFont::loadAtlas(const char *filename, BmpFont *const *fonts, const char *const *names, int count)
+{
+    std::FILE *fp = std::fopen(filename, "rb");
+    if (!fp)
+        return false;
+
+    u8 magic[4];
+    u32 width = 0, height = 0, dataSize = 0;
+    u8 format = 0, fontCount = 0;
+    std::fread(magic, 1, 4, fp);
+    std::fread(&width, 4, 1, fp);
+    std::fread(&height, 4, 1, fp);
+    std::fread(&format, 1, 1, fp);
+    std::fread(&fontCount, 1, 1, fp);
+
+    // GlyphBatch tints these with the text color; other formats would need a texture
+    // environment of their own
+    bool formatOk = (format == TEXFMT_RGBA8 || format == TEXFMT_A8 || format == TEXFMT_A4 || format == TEXFMT_IA4);
+    if (std::memcmp(magic, "BFA\x02", 4) != 0 || !formatOk) {
+        std::fclose(fp);
+        return false;
+    }
+
+    std::vector<std::shared_ptr<FontData>> loaded(fontCount);
+    std::vector<std::string> loadedNames(fontCount);
+
+    for (int i=0; i<fontCount; ++i) {
+        char name[17] = {};
+        loaded[i].reset(new FontData());
+        FontData &font = *loaded[i];
+        std::fread(name, 1, 16, fp);
+        std::fread(&font.originX, 4, 1, fp);
+        std::fread(&font.originY, 4, 1, fp);
+        std::fread(&font.imgWidth, 4, 1, fp);
+        std::fread(&font.imgHeight, 4, 1, fp);
+        std::fread(&font.cellWidth, 4, 1, fp);
+        std::fread(&font.cellHeight, 4, 1, fp);
+        std::fread(&font.baseChar, 1, 1, fp);
+        std::fread(font.charWidths, 1, 256, fp);
+        loadedNames[i] = name;
+    }
+
+    std::fread(&dataSize, 4, 1, fp);
+
+    // Every requested font has to be in the atlas, otherwise none of them are touched.
+    std::vector<int> found(count, -1);
+    bool ok = true;
+    for (int i=0; i<count; ++i) {
+        for (int j=0; j<fontCount; ++j) {
+            if (loadedNames[j] == names[i])
+                found[i] = j;
+        }
+        if (found[i] < 0)
+            ok = false;
+    }
+
+    // The texture data is already tiled the way the GPU wants it, so it goes straight from the
+    // file into the texture's memory.
+    std::shared_ptr<sf2d_texture> texture;
+    if (ok) {
+        texture.reset(sf2d_create_texture(width, height, (sf2d_texfmt)format, SF2D_PLACE_RAM), sf2d_free_texture);
+        ok = texture && (u32)texture->data_size == dataSize && std::fread(texture->data, 1, dataSize, fp) == dataSize;
+    }
+
+    std::fclose(fp);
+
+    if (!ok)
+        return false;
+
+    GSPGPU_FlushDataCache(texture->data, dataSize);
+
+    for (int i=0; i<count; ++i) {
+        loaded[found[i]]->texture = texture;
+        fonts[i]->data = loaded[found[i]];
+    }
+
+    // For the debugger's (or emulator's) log
+    if (count > 0) {
+        char report[96];
+        int length = std::snprintf(report, sizeof(report), "%s: %lu byte texture, %lu less than RGBA8\n",
+            filename, (unsigned long)fonts[0]->textureSize(), (unsigned long)fonts[0]->textureSizeSaved());
+        svcOutputDebugString(report, std::min(length, (int)sizeof(report) - 1));
+    }
+
+    return true;
+}
+
+void BmpFont::setBatch(GlyphBatch *batch)
+{
+    BmpFont::batch = batch;
+}
+
+// Draws the text queued so far, so what is drawn next goes over it
+void BmpFont::flushBatch()
+{
+    if (batch)
+        batch->Flush();
+}
+
 u8 BmpFont::drawChar(char ch, int x, int y, u32 color) const
 {
     u8 cols = data->imgWidth / data->cellWidth;
-    u8 rows = data->imgHeight / data->cellHeight;
-    unsigned char maxChar = std::min((int)data->baseChar + (cols * rows - 1), 255);
     unsigned char uc = ch;
 
-    if (data->baseChar <= uc && uc <= maxChar) {
+    if (hasGlyph(uc)) {
         int tx = ((uc - data->baseChar) % cols) * data->cellWidth;
         int ty = ((uc - data->baseChar) / cols) * data->cellHeight;
         int width = data->cellWidth;
@@ -124,8 +295,15 @@ u8 BmpFont::drawChar(char ch, int x, int y, u32 color) const
                 height = clipBottom - y;
         }
 
-        if (width > 0 && height > 0)
-            sf2d_draw_texture_part_blend(data->texture, x, y, tx, ty, width, height, color);
+        tx += data->originX;
+        ty += data->originY;
+
+        if (width > 0 && height > 0) {
+            if (batch)
+                batch->Add(data->texture.get(), x, y, tx, ty, width, height, color);
+            else
+                GlyphBatch::Draw(data->texture.get(), x, y, tx, ty, width, height, color);
+        }
 
         return data->charWidths[uc];
     } else {
@@ -133,167 +311,200 @@ u8 BmpFont::drawChar(char ch, int x, int y, u32 color) const
     }
 }
 
-void BmpFont::splitToLines(const std::string &str, std::vector<std::string> &lines, int wrapWidth) const
+bool BmpFont::hasGlyph(unsigned char uc) const
+{
+    u8 cols = data->imgWidth / data->cellWidth;
+    u8 rows = data->imgHeight / data->cellHeight;
+    unsigned char maxChar = std::min((int)data->baseChar + (cols * rows - 1), 255);
+    return data->baseChar <= uc && uc <= maxChar;
+}
+
+void BmpFont::finishLine(TextLayout &layout, std::size_t lineStart, u32 lineWidth) const
 {
-    lines.clear();
+    int offset = 0;
+    if (alignment == ALIGN_RIGHT) {
+        offset = -(int)lineWidth;
+    } else if (alignment == ALIGN_CENTER) {
+        offset = -(int)(lineWidth / 2);
+    }
+
+    s16 y = layout.lines * data->cellHeight;
+    for (std::size_t i=lineStart; i<layout.glyphs.size(); ++i) {
+        layout.glyphs[i].x += offset;
+        layout.glyphs[i].y = y;
+    }
+
+    if (lineWidth > layout.width)
+        layout.width = lineWidth;
+    ++layout.lines;
+}
+
+void BmpFont::buildLayout(TextLayout &layout, const char *str, int wrapWidth) const
+{
+    layout.glyphs.clear();
+    layout.text = str;
+    layout.font = data.get();
+    layout.wrapWidth = wrapWidth;
+    layout.alignment = alignment;
+    layout.width = 0;
+    layout.lines = 0;
+
+    // Blank glyphs are left out, since there's nothing to draw for them.
+    auto addGlyph = [&](char ch, u32 x) {
+        unsigned char uc = ch;
+        if (uc != ' ' && hasGlyph(uc))
+            layout.glyphs.push_back({ (s16)x, 0, uc });
+    };
+
+    std::size_t lineStart = 0;
+
     if (wrapWidth == 0) {
         // No wrapping
-        std::stringstream curLine;
-        for (const auto &ch : str) {
+        u32 curX = 0;
+        for (const char *p = str; *p; ++p) {
+            char ch = *p;
             if (ch == '\n') {
-                lines.push_back(curLine.str());
-                curLine.str("");
+                finishLine(layout, lineStart, curX);
+                lineStart = layout.glyphs.size();
+                curX = 0;
             } else {
-                curLine << ch;
+                addGlyph(ch, curX);
+                curX += data->charWidths[(unsigned char)ch];
             }
         }
-        lines.push_back(curLine.str());
+        finishLine(layout, lineStart, curX);
     } else if (wrapWidth > 0) {
         // Word wrap
-        std::vector<std::string> words;
-        std::stringstream curWord;
+        std::string wordChars;
+        std::vector<std::size_t> wordEnds;
         u32 curX = 0;
 
-        for (const auto &ch : str) {
+        for (const char *p = str; *p; ++p) {
+            char ch = *p;
             u8 curCharWidth = data->charWidths[(unsigned char)ch];
             bool ignoreWhitespace = false;
 
             if (curX + curCharWidth > (unsigned)wrapWidth) {
-                words.push_back(curWord.str());
-                curWord.str("");
+                wordEnds.push_back(wordChars.size());
                 curX = 0;
                 ignoreWhitespace = true;
             }
 
             if ((!ignoreWhitespace || ch != ' ') && ch != '\n') {
-                curWord << ch;
+                wordChars += ch;
                 curX += curCharWidth;
             }
 
             if (ch == ' ' || ch == '\n' || ch == '-') {
-                words.push_back(curWord.str());
-                curWord.str("");
+                wordEnds.push_back(wordChars.size());
                 curX = 0;
-                if (ch == '\n')
-                    words.push_back("\n");
+                if (ch == '\n') {
+                    wordChars += '\n';
+                    wordEnds.push_back(wordChars.size());
+                }
             }
         }
 
-        std::string lastWord = curWord.str();
-        if (!lastWord.empty())
-            words.push_back(lastWord);
+        if (wordChars.size() > (wordEnds.empty() ? 0 : wordEnds.back()))
+            wordEnds.push_back(wordChars.size());
 
-        std::stringstream curLine;
+        std::size_t wordStart = 0;
+        std::size_t lineLength = 0;
         curX = 0;
 
-        for (const auto &word : words) {
-            u32 curWidth = getLineWidth(word);
+        for (const auto &wordEnd : wordEnds) {
+            bool newline = (wordEnd > wordStart && wordChars[wordStart] == '\n');
+            u32 curWidth = 0;
+            for (std::size_t i=wordStart; i<wordEnd; ++i) {
+                curWidth += data->charWidths[(unsigned char)wordChars[i]];
+            }
 
-            if (curX + curWidth > (unsigned)wrapWidth || word[0] == '\n') {
-                lines.push_back(curLine.str());
-                curLine.str("");
+            if (curX + curWidth > (unsigned)wrapWidth || newline) {
+                finishLine(layout, lineStart, curX);
+                lineStart = layout.glyphs.size();
+                lineLength = 0;
                 curX = 0;
             }
 
-            if (word[0] != '\n') {
-                curLine << word;
-                curX += curWidth;
+            if (!newline) {
+                for (std::size_t i=wordStart; i<wordEnd; ++i) {
+                    addGlyph(wordChars[i], curX);
+                    curX += data->charWidths[(unsigned char)wordChars[i]];
+                }
+                lineLength += wordEnd - wordStart;
             }
+
+            wordStart = wordEnd;
         }
 
-        std::string lastLine = curLine.str();
-        if (!lastLine.empty())
-            lines.push_back(lastLine);
+        if (lineLength > 0)
+            finishLine(layout, lineStart, curX);
     } else {
         // Character wrap
         wrapWidth = -wrapWidth;
-        std::stringstream curLine;
         u32 curX = 0;
 
-        for (const auto &ch : str) {
+        for (const char *p = str; *p; ++p) {
+            char ch = *p;
             unsigned char uc = ch;
             if (ch == '\n' || curX + data->charWidths[uc] > (unsigned)wrapWidth) {
-                lines.push_back(curLine.str());
-                curLine.str("");
+                finishLine(layout, lineStart, curX);
+                lineStart = layout.glyphs.size();
                 curX = 0;
             }
             if (ch != '\n') {
-                curLine << ch;
+                addGlyph(ch, curX);
                 curX += data->charWidths[uc];
             }
         }
 
-        lines.push_back(curLine.str());
+        finishLine(layout, lineStart, curX);
     }
+
+    layout.height = layout.lines * data->cellHeight;
 }
 
-u32 BmpFont::drawStrInternal(const std::string &str, int x, int y, u32 color) const
+const TextLayout &BmpFont::layoutStr(TextLayout &layout, const std::string &str, int wrapWidth) const
 {
-    u32 curX = 0;
-    u32 width = 0;
-
-    if (alignment == ALIGN_RIGHT) {
-        x -= getTextWidth(str);
-    } else if (alignment == ALIGN_CENTER) {
-        x -= getTextWidth(str) / 2;
-    }
-
-    for (const auto &ch : str) {
-        curX += drawChar(ch, x + curX, y, color);
-        if (curX > width) width = curX;
-    }
-    return width;
+    return layoutStr(layout, str.c_str(), wrapWidth);
 }
 
-u32 BmpFont::drawStr(const std::string &str, int x, int y, u32 color) const
+const TextLayout &BmpFont::layoutStr(TextLayout &layout, const char *str, int wrapWidth) const
 {
-    std::vector<std::string> lines;
-    splitToLines(str, lines, 0);
-
-    u32 width = 0;
-    for (std::size_t i=0; i<lines.size(); ++i) {
-        u32 curWidth = drawStrInternal(lines[i], x, y+data->cellHeight*i, color);
-        if (curWidth > width)
-            width = curWidth;
-    }
-
-    return width;
+    if (layout.font != data.get() || layout.wrapWidth != wrapWidth || layout.alignment != alignment || layout.text != str)
+        buildLayout(layout, str, wrapWidth);
+    return layout;
 }
 
-u32 BmpFont::drawStrWrap(const std::string &str, int x, int y, int wrapWidth, u32 color) const
+u32 BmpFont::drawLayout(const TextLayout &layout, int x, int y, u32 color) const
 {
-    std::vector<std::string> lines;
-    splitToLines(str, lines, wrapWidth);
-
-    for (std::size_t i=0; i<lines.size(); ++i) {
-        drawStrInternal(lines[i], x, y+data->cellHeight*i, color);
+    for (const auto &glyph : layout.glyphs) {
+        drawChar(glyph.ch, x + glyph.x, y + glyph.y, color);
     }
+    return layout.width;
+}
 
-    return lines.size() * data->cellHeight;
+u32 BmpFont::drawStr(const std::string &str, int x, int y, u32 color) const
+{
+    TextLayout layout;
+    buildLayout(layout, str.c_str(), 0);
+    return drawLayout(layout, x, y, color);
 }
 
-u32 BmpFont::getLineWidth(const std::string &line) const
+u32 BmpFont::drawStrWrap(const std::string &str, int x, int y, int wrapWidth, u32 color) const
 {
-    u32 width = 0;
-    for (const auto &ch : line) {
-        width += data->charWidths[(unsigned char)ch];
-    }
-    return width;
+    TextLayout layout;
+    buildLayout(layout, str.c_str(), wrapWidth);
+    drawLayout(layout, x, y, color);
+    return layout.height;
 }
 
 void BmpFont::getTextDims(const std::string &str, u32 &width, u32 &height, int wrapWidth) const
 {
-    std::vector<std::string> lines;
-    splitToLines(str, lines, wrapWidth);
-
-    width = 0;
-    for (const auto &line : lines) {
-        u32 curWidth = getLineWidth(line);
-        if (curWidth > width)
-            width = curWidth;
-    }
-
-    height = lines.size() * data->cellHeight;
+    TextLayout layout;
+    buildLayout(layout, str.c_str(), wrapWidth);
+    width = layout.width;
+    height = layout.height;
 }
 
 u32 BmpFont::getTextWidth(const std::string &str, int wrapWidth) const
@@ -377,3 +588,19 @@ u32 BmpFont::height() const
 {
     return data->cellHeight;
 }
+
+u8 BmpFont::charWidth(char ch) const
+{
+    return data->charWidths[(unsigned char)ch];
+}
+
+u32 BmpFont::textureSize() const
+{
+    return data->texture->data_size;
+}
+
+u32 BmpFont::textureSizeSaved() const
+{
+    u32 rgba8Size = data->texture->pow2_w * data->texture->pow2_h * 4;
+    return rgba8Size - data->texture->data_size;
+}
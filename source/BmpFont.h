@@ -18,37 +18,75 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 enum TextAlignment { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
 
+class GlyphBatch;
+
+// Line breaks and glyph positions for a string, computed once by BmpFont::layoutStr and then
+// drawn as often as needed with BmpFont::drawLayout, which doesn't allocate.
+class TextLayout
+{
+    friend class BmpFont;
+
+    struct Glyph
+    {
+        s16 x, y;
+        unsigned char ch;
+    };
+
+    std::vector<Glyph> glyphs;
+    std::string text;
+    const void *font;
+    int wrapWidth;
+    TextAlignment alignment;
+    u32 width, height, lines;
+
+public:
+    TextLayout();
+
+    void invalidate();
+    u32 getWidth() const;
+    u32 getHeight() const;
+    u32 getLineCount() const;
+};
+
 class BmpFont
 {
 private:
     struct FontData
     {
-        sf2d_texture *texture;
+        std::shared_ptr<sf2d_texture> texture; // may be shared with other fonts from the same atlas
+        u32 originX, originY;
         u32 imgWidth, imgHeight;
         u32 cellWidth, cellHeight;
         unsigned char baseChar;
         u8 charWidths[256];
-        ~FontData();
     };
     
     std::shared_ptr<FontData> data;
     TextAlignment alignment;
     int clipLeft, clipTop, clipRight, clipBottom;
     
+    static GlyphBatch *batch;
+    
     static constexpr u32 WHITE = RGBA8(0xFF, 0xFF, 0xFF, 0xFF);
     
-    void splitToLines(const std::string &str, std::vector<std::string> &lines, int wrapWidth) const;
-    u32 drawStrInternal(const std::string &str, int x, int y, u32 color) const;
-    u32 getLineWidth(const std::string &line) const;
+    bool hasGlyph(unsigned char uc) const;
+    void buildLayout(TextLayout &layout, const char *str, int wrapWidth) const;
+    void finishLine(TextLayout &layout, std::size_t lineStart, u32 lineWidth) const;
 
 public:
     BmpFont();
     BmpFont(const char *filename);
     
     bool load(const char *filename);
+    static bool loadAtlas(const char *filename, BmpFont *const *fonts, const char *const *names, int count);
+    static void setBatch(GlyphBatch *batch);
+    static void flushBatch();
     u8 drawChar(char ch, int x, int y, u32 color = WHITE) const;
     u32 drawStr(const std::string &str, int x, int y, u32 color = WHITE) const;
     u32 drawStrWrap(const std::string &str, int x, int y, int wrapWidth, u32 color = WHITE) const;
+    const TextLayout &layoutStr(TextLayout &layout, const std::string &str, int wrapWidth = 0) const;
+    const TextLayout &layoutStr(TextLayout &layout, const char *str, int wrapWidth = 0) const;
+    u32 drawLayout(const TextLayout &layout, int x, int y, u32 color = WHITE) const;
     void getTextDims(const std::string &str, u32 &width, u32 &height, int wrapWidth = 0) const;
     u32 getTextWidth(const std::string &str, int wrapWidth = 0) const;
     u32 getTextHeight(const std::string &str, int wrapWidth = 0) const;
@@ -65,4 +103,10 @@ public:
     
     operator bool() const;
     u32 height() const;
+    u8 charWidth(char ch) const;
+
+    // Memory used by the font's texture, and how much less that is than an RGBA8 texture of the
+    // same size. Fonts loaded from the same atlas share their texture.
+    u32 textureSize() const;
+    u32 textureSizeSaved() const;
 };
\ No newline at end of file
@@ -28,7 +28,8 @@ void Button::Draw(int x, int y, int w, int h)
 {
 	u32 c_on = altMode ? color_on_alt : color_on;
 	u32 c_off = altMode ? color_off_alt : color_off;
-	const char *str = (altMode ? text_alt : text).c_str();
+	const std::string &str = altMode ? text_alt : text;
+	TextLayout &label = altMode ? layout_alt : layout;
 	
     bool pressed = (GetTouchState() == TS_TOUCHING);
     if (!pressed) {
@@ -40,7 +41,7 @@ void Button::Draw(int x, int y, int w, int h)
 	
 	int textX = x + w/2;
 	int textY = y + h/2 - btnFont.height() / 2;
-    btnFont.align(ALIGN_CENTER).drawStr(str, textX, textY);
+    btnFont.drawLayout(btnFont.align(ALIGN_CENTER).layoutStr(label, str), textX, textY);
 }
 
 void Button::SetText(const std::string &text)
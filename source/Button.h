@@ -2,6 +2,7 @@
 #include <sf2d.h>
 #include <functional>
 #include <string>
+#include "BmpFont.h"
 #include "Control.h"
 
 class Button : public Control
@@ -12,6 +13,7 @@ public:
 	
 private:
 	std::string text, text_alt;
+	TextLayout layout, layout_alt;
 	u32 color_off, color_on, color_off_alt, color_on_alt;
 	callback_t callback;
 	
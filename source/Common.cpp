@@ -8,11 +8,14 @@ float Interpolate(float value, float inputMin, float inputMax, float outputMin,
 
 std::string vssprintf(const char *format, va_list arg)
 {
-    int size = vsnprintf(nullptr, 0, format, arg);
-    char *buf = new char[size + 1];
-    vsnprintf(buf, size + 1, format, arg);
-    std::string str = buf;
-    delete[] buf;
+    // The first pass consumes arg, so it needs its own copy.
+    va_list argCopy;
+    va_copy(argCopy, arg);
+    int size = vsnprintf(nullptr, 0, format, argCopy);
+    va_end(argCopy);
+    
+    std::string str(size, '\0');
+    vsnprintf(&str[0], size + 1, format, arg);
     return str;
 }
 
@@ -25,7 +25,7 @@ void Control::Click()
 {
 }
 
-void Control::TouchingInside(int x, int y)
+void Control::TouchPress(int x, int y)
 {
 	TouchState oldState = touchState;
 	touchState = TS_TOUCHING;
@@ -34,12 +34,12 @@ void Control::TouchingInside(int x, int y)
 	}
 }
 
-void Control::TouchingOutside(int x, int y)
+void Control::TouchMove(int x, int y, bool inside)
 {
-	touchState = TS_ACTIVE;
+	touchState = inside ? TS_TOUCHING : TS_ACTIVE;
 }
 
-void Control::NotTouching()
+void Control::TouchRelease()
 {
 	TouchState oldState = touchState;
 	touchState = TS_INACTIVE;
@@ -22,9 +22,12 @@ public:
 	virtual ~Control(); //for deleting without knowing control type
 
 	virtual void Draw(int x, int y, int w, int h);
-	virtual void TouchingInside(int x, int y);
-	virtual void TouchingOutside(int x, int y);
-	virtual void NotTouching();
+	
+	// Touch events are edge-triggered: a control only hears about a touch it was pressed by,
+	// and only when something changes. Coordinates are relative to the control's cell.
+	virtual void TouchPress(int x, int y);
+	virtual void TouchMove(int x, int y, bool inside);
+	virtual void TouchRelease();
 	
 	TouchState GetTouchState() const;
 };
\ No newline at end of file
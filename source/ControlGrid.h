@@ -16,8 +16,9 @@ public:
 template <int _Rows, int _Cols>
 class ControlGrid : public TableLayout<Control*, _Rows, _Cols>, public ControlGridBase
 {
-	TableCell<Control*> *activeCell = nullptr;
+	int activeIndex = -1;
 	bool wasTouchingBefore = false;
+	int lastX = 0, lastY = 0;
 	
 private:
 	void Initialize()
@@ -49,41 +50,55 @@ public:
 	
 	void Draw()
 	{
-		auto iter = this->EnumerateCells();
-		TableCell<Control*> *cell;
-		Rect<int> rect;
-		while ((cell = iter.NextCell(rect)) != nullptr) {
+		int count = this->GetCellCount();
+		for (int i=0; i<count; i++) {
+			TableCell<Control*> *cell = this->GetCell(i);
+			const Rect<int> &rect = this->GetCellRect(i);
 			if (cell->content != nullptr) {
 				cell->content->Draw(offsetX + rect.x, offsetY + rect.y, rect.w, rect.h);
 			}
 		}
 	}
 	
+	// Turns the per-frame touch state into press/move/release events. Only the active control
+	// (the one that was pressed) receives them, so a frame without a change in the touch does no
+	// per-control work. If the press didn't land on a control, the first control the stylus moves
+	// onto becomes the active one.
 	void ScreenTouchStatus(bool touching, int x, int y)
 	{
 		x -= offsetX; y -= offsetY;
-		auto iter = this->EnumerateCells();
-		TableCell<Control*> *cell;
-		Rect<int> rect;
-		while ((cell = iter.NextCell(rect)) != nullptr) {
-			if (cell->content != nullptr) {
-				if (touching && rect.PointInside(x, y)) {
-					if (!wasTouchingBefore) {
-						activeCell = cell;
-					}
-					if (activeCell == cell || activeCell == nullptr) {
-						cell->content->TouchingInside(x - rect.x, y - rect.y);
-					}
-				} else if (touching && cell == activeCell) {
-					cell->content->TouchingOutside(x - rect.x, y - rect.y);
-				} else {
-					cell->content->NotTouching();
-				}
+		
+		if (!touching) {
+			if (wasTouchingBefore && activeIndex >= 0) {
+				this->GetCell(activeIndex)->content->TouchRelease();
 			}
+			activeIndex = -1;
+			wasTouchingBefore = false;
+			return;
 		}
-		if (!touching) {
-			activeCell = nullptr;
+		
+		if (wasTouchingBefore && x == lastX && y == lastY) {
+			return;
+		}
+		
+		int hitIndex = this->CellIndexAtCoords(x, y);
+		if (hitIndex >= 0 && this->GetCell(hitIndex)->content == nullptr) {
+			hitIndex = -1;
+		}
+		
+		if (activeIndex < 0) {
+			if (hitIndex >= 0) {
+				activeIndex = hitIndex;
+				const Rect<int> &rect = this->GetCellRect(activeIndex);
+				this->GetCell(activeIndex)->content->TouchPress(x - rect.x, y - rect.y);
+			}
+		} else {
+			const Rect<int> &rect = this->GetCellRect(activeIndex);
+			this->GetCell(activeIndex)->content->TouchMove(x - rect.x, y - rect.y, hitIndex == activeIndex);
 		}
-		wasTouchingBefore = touching;
+		
+		lastX = x;
+		lastY = y;
+		wasTouchingBefore = true;
 	}
 };
\ No newline at end of file
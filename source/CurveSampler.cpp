@@ -0,0 +1,219 @@
+#include "CurveSampler.h"
+#include <algorithm>
+#include <cmath>
+
+// Longest segment left as it is, in pixels
+static constexpr float maxLength = 4.0f;
+// Segments still this long when refinement stops are taken to jump across a discontinuity
+static constexpr float breakLength = 32.0f;
+// Cosine of the sharpest turn between two segments left as it is (about 16 degrees)
+static constexpr float minTurnCos = 0.96f;
+
+static bool IsDefined(float sx, float sy)
+{
+	return std::isfinite(sx) && std::isfinite(sy);
+}
+
+// True if both points are past the same edge of the screen, so the segment can't be seen
+static bool IsOffScreen(float ax, float ay, float bx, float by)
+{
+	const float margin = 2.0f;
+	return (ax < -margin && bx < -margin) || (ax > 399 + margin && bx > 399 + margin) ||
+		(ay < -margin && by < -margin) || (ay > 239 + margin && by > 239 + margin);
+}
+
+// True if the path a -> b -> c turns more sharply than minTurnCos at b
+static bool TurnsSharply(float ax, float ay, float bx, float by, float cx, float cy)
+{
+	float ux = bx - ax, uy = by - ay;
+	float vx = cx - bx, vy = cy - by;
+	float dot = ux * vx + uy * vy;
+	float lengths = (ux * ux + uy * uy) * (vx * vx + vy * vy);
+	return dot < 0 || dot * dot < minTurnCos * minTurnCos * lengths;
+}
+
+CurveSampler::CurveSampler()
+{
+	mode = M_PARAMETRIC;
+}
+
+// Evaluates the curve at every t in ts, all in one batch
+void CurveSampler::EvaluateBlock(const RpnEnvironment &env, const ViewWindow &view, const float *const *plotLanes)
+{
+	int n = ts.size();
+	xs.resize(n);
+	ys.resize(n);
+	sxs.resize(n);
+	sys.resize(n);
+	
+	// The plots read are sampled by column, not by t
+	const float *const *refs = nullptr;
+	if (plotLanes != nullptr && !plotRefs.empty()) {
+		columns.resize(n);
+		view.MapToScreenX(&ts[0], &columns[0], n);
+		for (std::size_t j=0; j<plotRefs.size(); j++) {
+			const float *samples = plotLanes[plotRefs[j]];
+			std::vector<float> &values = refValues[j];
+			values.resize(n);
+			for (int i=0; i<n; i++) {
+				float column = columns[i] + 0.5f;
+				values[i] = (column >= 0 && column < COLUMNS) ? samples[(int)column] : NAN;
+			}
+			refLanes[plotRefs[j]] = &values[0];
+		}
+		refs = &refLanes[0];
+	}
+	
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_T] = &ts[0];
+	float *outs[] = { &xs[0], &ys[0] };
+	batch.Evaluate(env, lanes, n, outs, refs);
+	
+	if (mode == M_POLAR) {
+		for (int i=0; i<n; i++) {
+			float r = xs[i];
+			xs[i] = r * std::cos(ts[i]);
+			ys[i] = r * std::sin(ts[i]);
+		}
+	}
+	
+	view.MapToScreenX(&xs[0], &sxs[0], n);
+	view.MapToScreenY(&ys[0], &sys[0], n);
+}
+
+// Whether the step between points i and i + 1 should be halved
+bool CurveSampler::NeedsRefining(std::size_t i) const
+{
+	const CurvePoint &a = points[i], &b = points[i + 1];
+	bool definedA = IsDefined(a.sx, a.sy), definedB = IsDefined(b.sx, b.sy);
+	
+	if (definedA != definedB) {
+		return true; // find where the curve starts or stops
+	}
+	if (!definedA) {
+		return false;
+	}
+	
+	if (IsOffScreen(a.sx, a.sy, b.sx, b.sy)) {
+		return false;
+	}
+	
+	float dx = b.sx - a.sx, dy = b.sy - a.sy;
+	float length2 = dx * dx + dy * dy;
+	if (length2 > maxLength * maxLength) {
+		return true;
+	}
+	if (length2 < 1.0f) {
+		return false;
+	}
+	
+	if (i > 0) {
+		const CurvePoint &prev = points[i - 1];
+		if (IsDefined(prev.sx, prev.sy) && TurnsSharply(prev.sx, prev.sy, a.sx, a.sy, b.sx, b.sy)) {
+			return true;
+		}
+	}
+	if (i + 2 < points.size()) {
+		const CurvePoint &next = points[i + 2];
+		if (IsDefined(next.sx, next.sy) && TurnsSharply(a.sx, a.sy, b.sx, b.sy, next.sx, next.sy)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+RpnInstruction::Status CurveSampler::Sample(const std::vector<RpnInstruction> &program, Mode mode, float tMin, float tMax, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY, const float *const *plotLanes)
+{
+	outX.clear();
+	outY.clear();
+	
+	this->mode = mode;
+	RpnInstruction::Status status = batch.Compile(program, (mode == M_PARAMETRIC) ? 2 : 1);
+	if (status != RpnInstruction::S_OK) {
+		return status;
+	}
+	
+	plotRefs.clear();
+	for (const RpnInstruction &inst : program) {
+		int plot = inst.GetPlot();
+		if (plot >= 0 && std::find(plotRefs.begin(), plotRefs.end(), plot) == plotRefs.end()) {
+			plotRefs.push_back(plot);
+		}
+	}
+	if (refValues.size() < plotRefs.size()) {
+		refValues.resize(plotRefs.size());
+	}
+	refLanes.assign(plotRefs.empty() ? 0 : *std::max_element(plotRefs.begin(), plotRefs.end()) + 1, nullptr);
+	
+	ts.clear();
+	for (int i=0; i<=INITIAL_STEPS; i++) {
+		ts.push_back(tMin + (tMax - tMin) * i / INITIAL_STEPS);
+	}
+	EvaluateBlock(env, view, plotLanes);
+	
+	points.clear();
+	for (std::size_t i=0; i<ts.size(); i++) {
+		points.push_back(CurvePoint{ts[i], xs[i], ys[i], sxs[i], sys[i], 0});
+	}
+	
+	for (int round=0; round<MAX_ROUNDS; round++) {
+		ts.clear();
+		refine.assign(points.size(), false);
+		for (std::size_t i=0; i+1<points.size() && points.size()+ts.size()<MAX_POINTS; i++) {
+			if (NeedsRefining(i)) {
+				refine[i] = true;
+				ts.push_back((points[i].t + points[i + 1].t) / 2);
+			}
+		}
+		if (ts.empty()) {
+			break;
+		}
+		
+		EvaluateBlock(env, view, plotLanes);
+		
+		merged.clear();
+		std::size_t k = 0;
+		for (std::size_t i=0; i<points.size(); i++) {
+			CurvePoint p = points[i];
+			if (refine[i]) {
+				++p.depth;
+				merged.push_back(p);
+				merged.push_back(CurvePoint{ts[k], xs[k], ys[k], sxs[k], sys[k], p.depth});
+				++k;
+			} else {
+				merged.push_back(p);
+			}
+		}
+		points.swap(merged);
+	}
+	
+	bool broken = true; // the last point written was a break
+	for (std::size_t i=0; i<points.size(); i++) {
+		const CurvePoint &p = points[i];
+		if (!IsDefined(p.sx, p.sy)) {
+			if (!broken) {
+				outX.push_back(NAN);
+				outY.push_back(NAN);
+				broken = true;
+			}
+			continue;
+		}
+		
+		outX.push_back(p.x);
+		outY.push_back(p.y);
+		broken = false;
+		
+		// Steps that were still to be halved when the rounds or the points ran out
+		if (i + 1 < points.size() && (p.depth >= MAX_ROUNDS || NeedsRefining(i))) {
+			const CurvePoint &q = points[i + 1];
+			float dx = q.sx - p.sx, dy = q.sy - p.sy;
+			if (IsDefined(q.sx, q.sy) && dx * dx + dy * dy > breakLength * breakLength) {
+				outX.push_back(NAN);
+				outY.push_back(NAN);
+				broken = true;
+			}
+		}
+	}
+	
+	return status;
+}
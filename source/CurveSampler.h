@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include "RpnBatch.h"
+#include "ViewWindow.h"
+
+// Samples a parametric or polar curve over a range of t. It starts from evenly spaced values of
+// t and keeps halving the steps whose segment is long or turns sharply on the screen, so points
+// end up where the curve needs them rather than evenly in t. Each round of new values of t is
+// evaluated in one batch, with x and y coming out of the same pass.
+// A plot the curve reads gives its value at x = t, from the screen column nearest to t, and is
+// undefined where t is off the screen.
+class CurveSampler
+{
+public:
+	enum Mode { M_PARAMETRIC, M_POLAR };
+	
+	static constexpr int COLUMNS = 400;
+	static constexpr int INITIAL_STEPS = 128;
+	static constexpr int MAX_POINTS = 4096;
+	static constexpr int MAX_ROUNDS = 8;
+	
+private:
+	struct CurvePoint
+	{
+		float t, x, y; // graph coordinates
+		float sx, sy; // screen coordinates, not finite if undefined
+		int depth; // how many times the step starting here was halved
+	};
+	
+	RpnBatch batch;
+	Mode mode;
+	std::vector<CurvePoint> points, merged;
+	std::vector<float> ts, xs, ys, sxs, sys;
+	std::vector<bool> refine;
+	
+	std::vector<int> plotRefs; // plots the program reads
+	std::vector<std::vector<float>> refValues; // their values at each t, in the order of plotRefs
+	std::vector<const float*> refLanes; // the same, by plot
+	std::vector<float> columns;
+	
+	void EvaluateBlock(const RpnEnvironment &env, const ViewWindow &view, const float *const *plotLanes);
+	bool NeedsRefining(std::size_t i) const;
+	
+public:
+	CurveSampler();
+	
+	// Writes the points of the curve in graph coordinates to outX and outY, with NaN where the
+	// curve is broken. A parametric program leaves x and y on the stack, a polar one leaves r.
+	// plotLanes holds each plot's value at each screen column, for the plots the program reads.
+	RpnInstruction::Status Sample(const std::vector<RpnInstruction> &program, Mode mode, float tMin, float tMax, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY, const float *const *plotLanes = nullptr);
+};
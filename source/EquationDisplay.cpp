@@ -0,0 +1,101 @@
+#include <sf2d.h>
+#include <algorithm>
+#include "EquationDisplay.h"
+
+extern BmpFont mainFont;
+
+EquationDisplay::EquationDisplay()
+{
+	textColor = RGBA8(0x00, 0x00, 0x00, 0xFF);
+	wrapWidth = 0;
+}
+
+void EquationDisplay::PlaceToken(std::size_t index)
+{
+	Token &token = tokens[index];
+	mainFont.layoutStr(token.layout, token.text.c_str());
+	int width = token.layout.getWidth();
+	if (wrapWidth > 0 && width > wrapWidth) {
+		mainFont.layoutStr(token.layout, token.text.c_str(), -wrapWidth); // between characters
+	}
+	
+	if (index == 0) {
+		token.x = 0;
+		token.line = 0;
+	} else {
+		const Token &prev = tokens[index - 1];
+		int prevLines = prev.layout.getLineCount();
+		token.x = prev.x + prev.layout.getWidth() + mainFont.charWidth(' ');
+		token.line = prev.line;
+		if (prevLines > 1 || token.layout.getLineCount() > 1 || (wrapWidth > 0 && token.x + width > wrapWidth)) {
+			token.x = 0;
+			token.line = prev.line + std::max(prevLines, 1);
+		}
+	}
+}
+
+void EquationDisplay::Draw(int x, int y, int w, int h)
+{
+	sf2d_draw_rectangle_gradient(x, y, w, h, RGBA8(0xD0, 0xD0, 0xD0, 0xFF), RGBA8(0xFF, 0xFF, 0xFF, 0xFF), SF2D_TOP_TO_BOTTOM);
+	
+	if (w - 4 != wrapWidth) {
+		wrapWidth = w - 4;
+		for (std::size_t i=0; i<tokens.size(); i++) {
+			PlaceToken(i);
+		}
+	}
+	
+	if (tokens.empty()) return;
+	
+	int lineHeight = mainFont.height();
+	int visibleLines = std::max(h / lineHeight, 1);
+	const Token &last = tokens.back();
+	int lastLine = last.line + std::max((int)last.layout.getLineCount(), 1) - 1;
+	int firstLine = std::max(lastLine - visibleLines + 1, 0);
+	
+	// A broken token can start above the first line shown, so the cell clips the text
+	std::size_t first = tokens.size();
+	while (first > 0 && tokens[first - 1].line + (int)tokens[first - 1].layout.getLineCount() > firstLine) {
+		--first;
+	}
+	
+	const BmpFont font = mainFont.clip(x, y, x + w, y + h);
+	for (std::size_t i=first; i<tokens.size(); i++) {
+		const Token &token = tokens[i];
+		font.drawLayout(token.layout, x + 4 + token.x, y + (token.line - firstLine) * lineHeight, textColor);
+	}
+}
+
+void EquationDisplay::Push(const char *text)
+{
+	tokens.push_back(Token());
+	tokens.back().text = text;
+	PlaceToken(tokens.size() - 1);
+}
+
+void EquationDisplay::Pop()
+{
+	if (!tokens.empty()) {
+		tokens.pop_back();
+	}
+}
+
+void EquationDisplay::ReplaceLast(const char *text)
+{
+	if (tokens.empty()) {
+		Push(text);
+	} else {
+		tokens.back().text = text;
+		PlaceToken(tokens.size() - 1);
+	}
+}
+
+void EquationDisplay::Clear()
+{
+	tokens.clear();
+}
+
+void EquationDisplay::SetTextColor(u32 color)
+{
+	textColor = color;
+}
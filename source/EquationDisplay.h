@@ -0,0 +1,38 @@
+#pragma once
+#include <3ds.h>
+#include <string>
+#include <vector>
+#include "BmpFont.h"
+#include "Control.h"
+
+// Shows an equation as a row of tokens, word-wrapped to the width of the cell. Each token's
+// text layout and position are kept, and since a token's position only depends on the tokens
+// before it, pushing, popping or replacing the last token only touches that token. A token
+// wider than the cell is broken between characters and takes lines of its own. Only the last
+// lines that fit in the cell are drawn.
+class EquationDisplay : public Control
+{
+	struct Token
+	{
+		std::string text;
+		TextLayout layout;
+		int x, line; // line is the first of the token's lines
+	};
+	
+	std::vector<Token> tokens;
+	u32 textColor;
+	int wrapWidth;
+	
+	void PlaceToken(std::size_t index);
+	
+public:
+	EquationDisplay();
+	
+	virtual void Draw(int x, int y, int w, int h);
+	
+	void Push(const char *text);
+	void Pop();
+	void ReplaceLast(const char *text);
+	void Clear();
+	void SetTextColor(u32 color);
+};
@@ -0,0 +1,102 @@
+#include "GlyphBatch.h"
+
+GlyphBatch::GlyphBatch()
+{
+	runCount = 0;
+	lastRun = -1;
+}
+
+void GlyphBatch::Add(const sf2d_texture *texture, int x, int y, int tx, int ty, int w, int h, u32 color)
+{
+	if (lastRun < 0 || runs[lastRun].texture != texture || runs[lastRun].color != color) {
+		lastRun = -1;
+		for (int i=0; i<runCount; i++) {
+			if (runs[i].texture == texture && runs[i].color == color) {
+				lastRun = i;
+				break;
+			}
+		}
+		
+		if (lastRun < 0) {
+			if (runCount == (int)runs.size()) {
+				runs.push_back(Run());
+			}
+			lastRun = runCount++;
+			runs[lastRun].texture = texture;
+			runs[lastRun].color = color;
+		}
+	}
+	
+	runs[lastRun].quads.push_back({ (s16)x, (s16)y, (s16)tx, (s16)ty, (s16)w, (s16)h });
+}
+
+void GlyphBatch::Flush()
+{
+	for (int i=0; i<runCount; i++) {
+		Run &run = runs[i];
+		Submit(run.texture, run.color, run.quads.data(), run.quads.size());
+		run.quads.clear();
+	}
+	
+	runCount = 0;
+	lastRun = -1;
+}
+
+void GlyphBatch::Draw(const sf2d_texture *texture, int x, int y, int tx, int ty, int w, int h, u32 color)
+{
+	Quad quad = { (s16)x, (s16)y, (s16)tx, (s16)ty, (s16)w, (s16)h };
+	Submit(texture, color, &quad, 1);
+}
+
+void GlyphBatch::Submit(const sf2d_texture *texture, u32 color, const Quad *quads, int count)
+{
+	int vertexCount = 6 * count;
+	sf2d_vertex_pos_tex *vertices = (sf2d_vertex_pos_tex*)sf2d_pool_memalign(vertexCount * sizeof(sf2d_vertex_pos_tex), 8);
+	if (vertices == nullptr) return;
+	
+	float texW = texture->pow2_w;
+	float texH = texture->pow2_h;
+	sf2d_vertex_pos_tex *v = vertices;
+	
+	for (int i=0; i<count; i++) {
+		const Quad &quad = quads[i];
+		float x0 = quad.x, y0 = quad.y;
+		float x1 = quad.x + quad.w, y1 = quad.y + quad.h;
+		float u0 = quad.tx / texW, v0 = quad.ty / texH;
+		float u1 = (quad.tx + quad.w) / texW, v1 = (quad.ty + quad.h) / texH;
+		
+		v[0] = { { x0, y0, 0.5f }, { u0, v0 } };
+		v[1] = { { x0, y1, 0.5f }, { u0, v1 } };
+		v[2] = { { x1, y0, 0.5f }, { u1, v0 } };
+		v[3] = v[2];
+		v[4] = v[1];
+		v[5] = { { x1, y1, 0.5f }, { u1, v1 } };
+		v += 6;
+	}
+	
+	sf2d_bind_texture_color(texture, GPU_TEXUNIT0, color);
+	
+	// Alpha-only textures sample as black, so the usual texture * color blend would turn all
+	// text black. Take the color from the blend color alone and only modulate the alpha; IA4
+	// goes the same way, so its intensity can't darken the text either. sf2d sets up the
+	// texture environment again on its next draw call.
+	if (texture->pixel_format == TEXFMT_A8 || texture->pixel_format == TEXFMT_A4 || texture->pixel_format == TEXFMT_IA4) {
+		C3D_TexEnv *env = C3D_GetTexEnv(0);
+		C3D_TexEnvSrc(env, C3D_RGB, GPU_CONSTANT, 0, 0);
+		C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+		C3D_TexEnvSrc(env, C3D_Alpha, GPU_TEXTURE0, GPU_CONSTANT, 0);
+		C3D_TexEnvFunc(env, C3D_Alpha, GPU_MODULATE);
+		C3D_TexEnvColor(env, color);
+	}
+	
+	// Don't rely on the attribute layout sf2d left behind: position, then texture coordinates
+	C3D_AttrInfo *attrInfo = C3D_GetAttrInfo();
+	AttrInfo_Init(attrInfo);
+	AttrInfo_AddLoader(attrInfo, 0, GPU_FLOAT, 3);
+	AttrInfo_AddLoader(attrInfo, 1, GPU_FLOAT, 2);
+	
+	C3D_BufInfo *bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, vertices, sizeof(sf2d_vertex_pos_tex), 2, 0x10);
+	C3D_DrawArrays(GPU_TRIANGLES, 0, vertexCount);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <sf2d.h>
+
+// Collects textured quads (normally font glyphs) over a frame and submits them with one draw
+// call per texture and color, instead of one call per quad. Flush() must be called before the
+// frame ends; quads are drawn in the order their texture/color pair was first used. Queued quads
+// are only drawn at the flush, so flush before drawing anything that should cover them.
+class GlyphBatch
+{
+	struct Quad
+	{
+		s16 x, y;
+		s16 tx, ty;
+		s16 w, h;
+	};
+	
+	struct Run
+	{
+		const sf2d_texture *texture;
+		u32 color;
+		std::vector<Quad> quads;
+	};
+	
+	// Runs past runCount are left over from earlier frames and keep their capacity.
+	std::vector<Run> runs;
+	int runCount;
+	int lastRun;
+	
+	static void Submit(const sf2d_texture *texture, u32 color, const Quad *quads, int count);
+	
+public:
+	GlyphBatch();
+	
+	void Add(const sf2d_texture *texture, int x, int y, int tx, int ty, int w, int h, u32 color);
+	void Flush();
+	
+	// Draws a single quad right away, with the same handling of texture formats as a batch.
+	static void Draw(const sf2d_texture *texture, int x, int y, int tx, int ty, int w, int h, u32 color);
+};
@@ -0,0 +1,475 @@
+#include "Heatmap.h"
+#include <algorithm>
+#include <cmath>
+
+struct Heatmap::Shared
+{
+	// One per thread, since a batch keeps its stack between instructions
+	struct Evaluator
+	{
+		RpnBatch batch;
+		RpnComplex complex;
+		std::vector<float> xs, ys, values, imags;
+		std::vector<int> indices;
+	};
+
+	Evaluator evaluators[2];
+	Thread worker;
+	bool workerStarted;
+	volatile bool quitting;
+	LightEvent start, done;
+	LightLock lock;
+
+	std::vector<Tile*> *jobs;
+	int nextJob;
+	const RpnEnvironment *env;
+	Mode mode;
+};
+
+Heatmap::Shared Heatmap::shared;
+
+Heatmap::Tile::Tile()
+{
+	levelX = levelY = 0;
+	tx = ty = 0;
+	generation = 0;
+	colorKey = 0;
+	lastUsed = 0;
+	evaluated = false;
+	texture = nullptr;
+}
+
+Heatmap::Tile::~Tile()
+{
+	if (texture != nullptr) {
+		sf2d_free_texture(texture);
+	}
+}
+
+Heatmap::Heatmap()
+{
+	levelX = levelY = 0;
+	frame = 0;
+	generation = 0;
+}
+
+static int FloorDiv(s64 value, int divisor)
+{
+	return (int)((value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor));
+}
+
+// log2 of the power of two spacing that puts samples between 2 and 4 pixels apart
+static int SampleLevel(float pixelSize)
+{
+	return (int)std::ceil(std::log2(2 * pixelSize));
+}
+
+// Finds the tile at (tx, ty) on the current grid, or recycles the one unused the longest
+Heatmap::Tile *Heatmap::GetTile(int tx, int ty)
+{
+	Tile *oldest = nullptr;
+	for (auto &tile : tiles) {
+		if (tile->levelX == levelX && tile->levelY == levelY && tile->tx == tx && tile->ty == ty) {
+			return tile.get();
+		}
+		if (tile->lastUsed != frame && (oldest == nullptr || tile->lastUsed < oldest->lastUsed)) {
+			oldest = tile.get();
+		}
+	}
+
+	Tile *tile;
+	if ((int)tiles.size() < MAX_TILES) {
+		tiles.push_back(std::unique_ptr<Tile>(new Tile()));
+		tile = tiles.back().get();
+	} else if (oldest != nullptr) {
+		tile = oldest;
+	} else {
+		return nullptr;
+	}
+
+	tile->levelX = levelX;
+	tile->levelY = levelY;
+	tile->tx = tx;
+	tile->ty = ty;
+	tile->evaluated = false;
+	tile->colorKey = 0;
+	return tile;
+}
+
+// Copies the samples that up to date tiles already have, from this grid or the ones a power of
+// two finer or coarser, and marks the rest as pending
+void Heatmap::Prepare(Tile &tile, u32 generation)
+{
+	s64 i0 = (s64)tile.tx * TILE, j0 = (s64)tile.ty * TILE;
+
+	sources.clear();
+	for (auto &other : tiles) {
+		int shift = tile.levelX - other->levelX;
+		if (other.get() == &tile || !other->evaluated || other->generation != generation ||
+			shift != tile.levelY - other->levelY || shift < -1 || shift > 1) {
+			continue;
+		}
+		// Whether the other tile overlaps this one, in samples of the other tile's grid
+		s64 oi = (s64)other->tx * TILE, oj = (s64)other->ty * TILE;
+		s64 i = (shift >= 0) ? i0 << shift : i0 >> 1, j = (shift >= 0) ? j0 << shift : j0 >> 1;
+		s64 size = (shift >= 0) ? (s64)TILE << shift : TILE / 2 + 1;
+		if (oi <= i + size && i <= oi + TILE && oj <= j + size && j <= oj + TILE) {
+			sources.push_back(other.get());
+		}
+	}
+
+	for (int b=0; b<SIDE; b++) {
+		for (int a=0; a<SIDE; a++) {
+			int index = b * SIDE + a;
+			tile.pending[index] = true;
+
+			for (Tile *source : sources) {
+				int shift = tile.levelX - source->levelX;
+				s64 i = i0 + a, j = j0 + b;
+				if (shift < 0) {
+					if ((i | j) & 1) {
+						continue; // between the samples of the coarser grid
+					}
+					i >>= 1;
+					j >>= 1;
+				} else {
+					i <<= shift;
+					j <<= shift;
+				}
+				s64 sa = i - (s64)source->tx * TILE, sb = j - (s64)source->ty * TILE;
+				if (sa >= 0 && sa <= TILE && sb >= 0 && sb <= TILE) {
+					tile.values[index] = source->values[sb * SIDE + sa];
+					tile.imag[index] = source->imag[sb * SIDE + sa];
+					tile.pending[index] = false;
+					break;
+				}
+			}
+		}
+	}
+}
+
+// Evaluates the pending samples of a tile in one batch
+void Heatmap::Evaluate(Tile &tile, int evaluator)
+{
+	Shared::Evaluator &e = shared.evaluators[evaluator];
+	e.xs.clear();
+	e.ys.clear();
+	e.indices.clear();
+	for (int b=0; b<SIDE; b++) {
+		for (int a=0; a<SIDE; a++) {
+			if (tile.pending[b * SIDE + a]) {
+				e.xs.push_back(std::ldexp((float)((s64)tile.tx * TILE + a), tile.levelX));
+				e.ys.push_back(std::ldexp((float)((s64)tile.ty * TILE + b), tile.levelY));
+				e.indices.push_back(b * SIDE + a);
+			}
+		}
+	}
+	if (e.indices.empty()) {
+		return;
+	}
+
+	int n = e.indices.size();
+	e.values.resize(n);
+	e.imags.assign(n, 0.0f);
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	if (shared.mode == M_COMPLEX) {
+		const float *imagLanes[RpnEnvironment::SLOT_COUNT] = {};
+		lanes[RpnEnvironment::VAR_X] = &e.xs[0];
+		imagLanes[RpnEnvironment::VAR_X] = &e.ys[0];
+		e.complex.Evaluate(*shared.env, lanes, imagLanes, n, &e.values[0], &e.imags[0]);
+	} else {
+		lanes[RpnEnvironment::VAR_X] = &e.xs[0];
+		lanes[RpnEnvironment::VAR_Y] = &e.ys[0];
+		e.batch.Evaluate(*shared.env, lanes, n, &e.values[0]);
+	}
+
+	for (int k=0; k<n; k++) {
+		tile.values[e.indices[k]] = e.values[k];
+		tile.imag[e.indices[k]] = e.imags[k];
+		tile.pending[e.indices[k]] = false;
+	}
+}
+
+// Takes tiles off the shared job list until it is empty
+void Heatmap::RunJobs(int evaluator)
+{
+	while (true) {
+		LightLock_Lock(&shared.lock);
+		int job = shared.nextJob++;
+		LightLock_Unlock(&shared.lock);
+
+		if (job >= (int)shared.jobs->size()) {
+			break;
+		}
+		Evaluate(*(*shared.jobs)[job], evaluator);
+	}
+}
+
+void Heatmap::WorkerMain(void *arg)
+{
+	while (true) {
+		LightEvent_Wait(&shared.start);
+		if (shared.quitting) {
+			break;
+		}
+		RunJobs(1);
+		LightEvent_Signal(&shared.done);
+	}
+}
+
+void Heatmap::StopWorker()
+{
+	if (shared.worker != nullptr) {
+		shared.quitting = true;
+		LightEvent_Signal(&shared.start);
+		threadJoin(shared.worker, U64_MAX);
+		threadFree(shared.worker);
+		shared.worker = nullptr;
+	}
+}
+
+// Diverging color map: blue below zero, red above, white at zero, with darker contour lines
+void Heatmap::Colorize(Tile &tile, float scale, bool contours, u32 colorKey)
+{
+	if (tile.texture == nullptr) {
+		tile.texture = sf2d_create_texture(TILE, TILE, TEXFMT_RGBA8, SF2D_PLACE_RAM);
+		if (tile.texture == nullptr) {
+			return;
+		}
+	}
+
+	u32 pixels[TILE * TILE];
+	float spacing = scale / 8;
+	for (int r=0; r<TILE; r++) {
+		int b = TILE - 1 - r; // rows go down the screen, samples go up
+		for (int a=0; a<TILE; a++) {
+			float f = tile.values[b * SIDE + a];
+			if (!std::isfinite(f)) {
+				pixels[r * TILE + a] = RGBA8(0xC0, 0xC0, 0xC0, 0xFF);
+				continue;
+			}
+
+			float t = std::max(-1.0f, std::min(1.0f, f / scale));
+			int fade = (int)(0xFF * (1.0f - std::abs(t)));
+			int red = (t < 0) ? fade : 0xFF;
+			int blue = (t > 0) ? fade : 0xFF;
+
+			if (contours) {
+				float level = std::floor(f / spacing);
+				float right = tile.values[b * SIDE + a + 1], up = tile.values[(b + 1) * SIDE + a];
+				if ((std::isfinite(right) && std::floor(right / spacing) != level) ||
+					(std::isfinite(up) && std::floor(up / spacing) != level)) {
+					red /= 2;
+					fade /= 2;
+					blue /= 2;
+				}
+			}
+			pixels[r * TILE + a] = RGBA8(red, fade, blue, 0xFF);
+		}
+	}
+
+	sf2d_fill_texture_from_RGBA8(tile.texture, pixels, TILE, TILE);
+	tile.colorKey = colorKey;
+}
+
+// Domain coloring: the hue goes round with the argument, red on the positive reals, and the
+// lightness goes from black at 0 to white at infinity, with darker lines where the modulus
+// crosses a power of two
+void Heatmap::ColorizeComplex(Tile &tile, bool contours, u32 colorKey)
+{
+	if (tile.texture == nullptr) {
+		tile.texture = sf2d_create_texture(TILE, TILE, TEXFMT_RGBA8, SF2D_PLACE_RAM);
+		if (tile.texture == nullptr) {
+			return;
+		}
+	}
+
+	u32 pixels[TILE * TILE];
+	for (int r=0; r<TILE; r++) {
+		int b = TILE - 1 - r;
+		for (int a=0; a<TILE; a++) {
+			int index = b * SIDE + a;
+			float re = tile.values[index], im = tile.imag[index];
+			float modulus = std::hypot(re, im);
+			if (std::isnan(modulus)) {
+				pixels[r * TILE + a] = RGBA8(0xC0, 0xC0, 0xC0, 0xFF);
+				continue;
+			}
+
+			float hue = std::atan2(im, re) * (float)(3 / M_PI); // 0 to 6, one unit per primary or secondary
+			if (hue < 0) {
+				hue += 6;
+			}
+			float light = std::atan(modulus) * (float)(2 / M_PI);
+			float chroma = 1.0f - std::abs(2 * light - 1);
+			float second = chroma * (1.0f - std::abs(std::fmod(hue, 2.0f) - 1));
+			float rgb[3] = {};
+			int sector = std::min(5, (int)hue);
+			int first = ((sector + 1) / 2) % 3; // the channel at full chroma in this sector
+			int other = (sector % 2 == 0) ? (first + 1) % 3 : (first + 2) % 3;
+			rgb[first] = chroma;
+			rgb[other] = second;
+			float base = light - chroma / 2;
+
+			if (contours && modulus > 0) {
+				float level = std::floor(std::log2(modulus));
+				float right = std::hypot(tile.values[index + 1], tile.imag[index + 1]);
+				float up = std::hypot(tile.values[index + SIDE], tile.imag[index + SIDE]);
+				if ((right > 0 && std::floor(std::log2(right)) != level) ||
+					(up > 0 && std::floor(std::log2(up)) != level)) {
+					for (float &c : rgb) {
+						c /= 2;
+					}
+					base /= 2;
+				}
+			}
+			pixels[r * TILE + a] = RGBA8((int)(0xFF * (rgb[0] + base)), (int)(0xFF * (rgb[1] + base)), (int)(0xFF * (rgb[2] + base)), 0xFF);
+		}
+	}
+
+	sf2d_fill_texture_from_RGBA8(tile.texture, pixels, TILE, TILE);
+	tile.colorKey = colorKey;
+}
+
+void Heatmap::Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view, bool contours, Mode mode)
+{
+	++frame;
+	visible.clear();
+	if (key != this->key) {
+		this->key = key;
+		++generation;
+	}
+
+	// The evaluators are shared by every heatmap, so they're compiled for this one each time
+	if (mode == M_COMPLEX) {
+		if (shared.evaluators[0].complex.Compile(program) != RpnInstruction::S_OK) {
+			return;
+		}
+		shared.evaluators[1].complex.Compile(program);
+	} else {
+		if (shared.evaluators[0].batch.Compile(program) != RpnInstruction::S_OK) {
+			return;
+		}
+		shared.evaluators[1].batch.Compile(program);
+	}
+
+	levelX = SampleLevel((view.xmax - view.xmin) / 399);
+	levelY = SampleLevel((view.ymax - view.ymin) / 239);
+	int txMin = FloorDiv((s64)std::floor(std::ldexp(view.xmin, -levelX)), TILE);
+	int txMax = FloorDiv((s64)std::ceil(std::ldexp(view.xmax, -levelX)), TILE);
+	int tyMin = FloorDiv((s64)std::floor(std::ldexp(view.ymin, -levelY)), TILE);
+	int tyMax = FloorDiv((s64)std::ceil(std::ldexp(view.ymax, -levelY)), TILE);
+
+	for (int ty=tyMin; ty<=tyMax; ty++) {
+		for (int tx=txMin; tx<=txMax; tx++) {
+			Tile *tile = GetTile(tx, ty);
+			if (tile != nullptr) {
+				tile->lastUsed = frame;
+				visible.push_back(tile);
+			}
+		}
+	}
+
+	// Tiles with nothing to show go first, then the stale ones. Tiles that could be copied
+	// entirely from other tiles are done straight away and don't count.
+	jobs.clear();
+	for (int pass=0; pass<2; pass++) {
+		for (Tile *tile : visible) {
+			bool stale = tile->evaluated && tile->generation != generation;
+			if ((pass == 0 ? !tile->evaluated : stale) && (int)jobs.size() < TILES_PER_FRAME) {
+				Prepare(*tile, generation);
+				if (std::find(tile->pending, tile->pending + SIDE * SIDE, true) != tile->pending + SIDE * SIDE) {
+					jobs.push_back(tile);
+				} else {
+					tile->generation = generation;
+					tile->evaluated = true;
+					tile->colorKey = 0;
+				}
+			}
+		}
+	}
+
+	if (!jobs.empty()) {
+		if (!shared.workerStarted) {
+			shared.workerStarted = true;
+			LightEvent_Init(&shared.start, RESET_ONESHOT);
+			LightEvent_Init(&shared.done, RESET_ONESHOT);
+			LightLock_Init(&shared.lock);
+			// The system core only runs application threads for the share of time set here
+			APT_SetAppCpuTimeLimit(30);
+			s32 priority = 0x30;
+			svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+			shared.worker = threadCreate(WorkerMain, nullptr, 16 * 1024, priority + 1, 1, false);
+		}
+
+		shared.jobs = &jobs;
+		shared.nextJob = 0;
+		shared.env = &env;
+		shared.mode = mode;
+		if (shared.worker != nullptr) {
+			LightEvent_Signal(&shared.start);
+			RunJobs(0);
+			LightEvent_Wait(&shared.done);
+		} else {
+			RunJobs(0);
+		}
+
+		for (Tile *tile : jobs) {
+			tile->generation = generation;
+			tile->evaluated = true;
+			tile->colorKey = 0;
+		}
+	}
+
+	if (mode == M_COMPLEX) {
+		// No scale to fit, so tiles are only colored again when they change
+		u32 colorKey = 0x200 + (contours ? 1 : 0);
+		for (Tile *tile : visible) {
+			if (tile->evaluated && tile->colorKey != colorKey) {
+				ColorizeComplex(*tile, contours, colorKey);
+			}
+		}
+		return;
+	}
+
+	// The color scale is the power of two above the largest value on screen, so it only
+	// changes (and every tile is colored again) when the values change a lot
+	float largest = 0.0f;
+	for (Tile *tile : visible) {
+		if (tile->evaluated) {
+			for (float f : tile->values) {
+				if (std::isfinite(f)) {
+					largest = std::max(largest, std::abs(f));
+				}
+			}
+		}
+	}
+	float scale = (largest > 0) ? std::ldexp(1.0f, (int)std::ceil(std::log2(largest))) : 1.0f;
+	u32 colorKey = (u32)std::ilogb(scale) * 2 + (contours ? 1 : 0) + 0x100;
+
+	for (Tile *tile : visible) {
+		if (tile->evaluated && tile->colorKey != colorKey) {
+			Colorize(*tile, scale, contours, colorKey);
+		}
+	}
+}
+
+void Heatmap::Draw(const ViewWindow &view) const
+{
+	for (const Tile *tile : visible) {
+		if (tile->texture == nullptr || tile->colorKey == 0) {
+			continue;
+		}
+
+		// Each texel is centered on its sample; edges are rounded so neighbours meet exactly
+		float xs[] = { std::ldexp(tile->tx * TILE - 0.5f, tile->levelX), std::ldexp(tile->tx * TILE + TILE - 0.5f, tile->levelX) };
+		float ys[] = { std::ldexp(tile->ty * TILE + TILE - 0.5f, tile->levelY), std::ldexp(tile->ty * TILE - 0.5f, tile->levelY) };
+		float sx[2], sy[2];
+		view.MapToScreenX(xs, sx, 2);
+		view.MapToScreenY(ys, sy, 2);
+
+		int x0 = (int)std::floor(sx[0] + 0.5f), x1 = (int)std::floor(sx[1] + 0.5f);
+		int y0 = (int)std::floor(sy[0] + 0.5f), y1 = (int)std::floor(sy[1] + 0.5f);
+		sf2d_draw_texture_scale(tile->texture, x0, y0, (float)(x1 - x0) / TILE, (float)(y1 - y0) / TILE);
+	}
+}
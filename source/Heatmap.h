@@ -0,0 +1,84 @@
+#pragma once
+#include <3ds.h>
+#include <sf2d.h>
+#include <memory>
+#include <vector>
+#include "InputKey.h"
+#include "RpnBatch.h"
+#include "RpnComplex.h"
+#include "ViewWindow.h"
+
+// Shades the whole top screen by the value of an equation of x and y, with optional contour
+// lines. The equation is sampled on a grid that is fixed in graph coordinates, with a spacing
+// that is a power of two between 2 and 4 pixels, and split into tiles of TILE x TILE samples.
+// Panning only evaluates the tiles coming into view. When zooming moves the spacing to the next
+// power of two, the samples the new grid shares with the old one are copied over, so only the
+// new ones are evaluated. Tiles are evaluated in batches, on a second core when there is one,
+// and at most TILES_PER_FRAME per frame; stale tiles stay on screen until their turn.
+// In complex mode x reads z = x + yi, and each sample is colored by the argument (hue) and the
+// modulus (lightness) of f(z).
+class Heatmap
+{
+public:
+	enum Mode { M_VALUE, M_COMPLEX };
+	
+	static constexpr int TILE = 16;
+	static constexpr int MAX_TILES = 192;
+	static constexpr int TILES_PER_FRAME = 32;
+
+private:
+	// Samples (a, b) with a and b from 0 to TILE, so each tile also holds the first row and
+	// column of its neighbours, which contour lines need
+	static constexpr int SIDE = TILE + 1;
+
+	struct Tile
+	{
+		int levelX, levelY; // log2 of the spacing between samples
+		int tx, ty; // sample (a, b) is at x = (tx * TILE + a) << levelX, likewise for y
+		u32 generation; // generation of the key the samples were computed for
+		u32 colorKey; // scale and contour setting the texture was colored with
+		u32 lastUsed;
+		bool evaluated;
+		float values[SIDE * SIDE];
+		float imag[SIDE * SIDE]; // imaginary parts, in complex mode
+		bool pending[SIDE * SIDE]; // samples still to be evaluated
+		sf2d_texture *texture;
+
+		Tile();
+		~Tile();
+	};
+
+	// State shared with the worker thread
+	struct Shared;
+	static Shared shared;
+
+	std::vector<std::unique_ptr<Tile>> tiles;
+	std::vector<Tile*> visible, jobs, sources;
+	int levelX, levelY;
+	u32 frame;
+	InputKey key;
+	u32 generation; // bumped when the key changes, so tiles don't each keep a copy of it
+
+	Tile *GetTile(int tx, int ty);
+	void Prepare(Tile &tile, u32 generation);
+	void Colorize(Tile &tile, float scale, bool contours, u32 colorKey);
+	void ColorizeComplex(Tile &tile, bool contours, u32 colorKey);
+
+	static void Evaluate(Tile &tile, int evaluator);
+	static void RunJobs(int evaluator);
+	static void WorkerMain(void *arg);
+
+public:
+	Heatmap();
+	Heatmap(const Heatmap&) = delete;
+	Heatmap &operator=(const Heatmap&) = delete;
+
+	// Brings the visible tiles up to date with key, the inputs of the program: the variables
+	// it reads, but not the view, which the tiles don't depend on. The key has to change with
+	// the mode too.
+	void Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view, bool contours, Mode mode = M_VALUE);
+	void Draw(const ViewWindow &view) const;
+
+	// Stops the worker thread; call before exiting
+	static void StopWorker();
+};
@@ -0,0 +1,141 @@
+#include "ImplicitPlotter.h"
+#include <cmath>
+
+// Graph coordinates of a point in pixels, which may be a fraction or past the screen edge
+static float GraphX(const ViewWindow &view, float px)
+{
+	return view.xmin + px * (view.xmax - view.xmin) / 399;
+}
+
+static float GraphY(const ViewWindow &view, float py)
+{
+	return view.ymax - py * (view.ymax - view.ymin) / 239;
+}
+
+// Keeps the cells of the given size where the equation might change sign, replacing them with
+// their four quarters unless they are already leaves
+void ImplicitPlotter::Subdivide(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, int size)
+{
+	RpnInterval::Range xRange, yRange;
+	const RpnInterval::Range *ranges[RpnEnvironment::SLOT_COUNT] = {};
+	ranges[RpnEnvironment::VAR_X] = &xRange;
+	ranges[RpnEnvironment::VAR_Y] = &yRange;
+
+	int half = size / 2;
+	next.clear();
+	for (const Cell &cell : cells) {
+		xRange.lo = GraphX(view, cell.x);
+		xRange.hi = GraphX(view, cell.x + size);
+		yRange.lo = GraphY(view, cell.y + size);
+		yRange.hi = GraphY(view, cell.y);
+
+		if (!interval.Evaluate(program, env, ranges).Contains(0.0f)) {
+			continue;
+		}
+
+		if (size <= LEAF_SIZE) {
+			next.push_back(cell);
+		} else {
+			for (int i=0; i<4; i++) {
+				Cell child = { (s16)(cell.x + (i & 1) * half), (s16)(cell.y + (i >> 1) * half) };
+				if (child.x < 400 && child.y < 240) {
+					next.push_back(child);
+				}
+			}
+		}
+	}
+
+	if (next.size() > MAX_LEAVES) {
+		next.resize(MAX_LEAVES);
+	}
+	cells.swap(next);
+}
+
+RpnInstruction::Status ImplicitPlotter::Plot(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY)
+{
+	outX.clear();
+	outY.clear();
+
+	RpnInstruction::Status status = batch.Compile(program);
+	if (status != RpnInstruction::S_OK) {
+		return status;
+	}
+
+	cells.clear();
+	for (int y=0; y<240; y+=ROOT_SIZE) {
+		for (int x=0; x<400; x+=ROOT_SIZE) {
+			cells.push_back(Cell{ (s16)x, (s16)y });
+		}
+	}
+	for (int size=ROOT_SIZE; size>=LEAF_SIZE; size/=2) {
+		Subdivide(program, env, view, size);
+	}
+	if (cells.empty()) {
+		return status;
+	}
+
+	// Corners of every leaf in the order top left, top right, bottom left, bottom right
+	int n = cells.size() * 4;
+	xs.resize(n);
+	ys.resize(n);
+	values.resize(n);
+	for (std::size_t i=0; i<cells.size(); i++) {
+		for (int k=0; k<4; k++) {
+			xs[i * 4 + k] = GraphX(view, cells[i].x + (k & 1) * LEAF_SIZE);
+			ys[i * 4 + k] = GraphY(view, cells[i].y + (k >> 1) * LEAF_SIZE);
+		}
+	}
+
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = &xs[0];
+	lanes[RpnEnvironment::VAR_Y] = &ys[0];
+	batch.Evaluate(env, lanes, n, &values[0]);
+
+	// Edges as pairs of corners: top, right, bottom, left
+	static const int edges[4][2] = { {0, 1}, {1, 3}, {2, 3}, {0, 2} };
+
+	for (std::size_t i=0; i<cells.size(); i++) {
+		const float *f = &values[i * 4];
+		const float *cx = &xs[i * 4], *cy = &ys[i * 4];
+		if (!std::isfinite(f[0]) || !std::isfinite(f[1]) || !std::isfinite(f[2]) || !std::isfinite(f[3])) {
+			continue;
+		}
+
+		// Where the curve crosses each edge, interpolating linearly between the corners
+		float px[4], py[4];
+		int crossings = 0;
+		for (int e=0; e<4; e++) {
+			int a = edges[e][0], b = edges[e][1];
+			if ((f[a] < 0) != (f[b] < 0)) {
+				float t = f[a] / (f[a] - f[b]);
+				px[crossings] = cx[a] + t * (cx[b] - cx[a]);
+				py[crossings] = cy[a] + t * (cy[b] - cy[a]);
+				++crossings;
+			}
+		}
+
+		int pairs[2][2] = { {0, 1}, {2, 3} };
+		int segments = crossings / 2;
+		if (crossings == 4) {
+			// Opposite corners agree: whether the centre sides with the top left one decides
+			// which corners get cut off
+			float centre = (f[0] + f[1] + f[2] + f[3]) / 4;
+			if ((centre < 0) != (f[0] < 0)) {
+				pairs[0][1] = 3;
+				pairs[1][0] = 1;
+				pairs[1][1] = 2;
+			}
+		}
+
+		for (int s=0; s<segments; s++) {
+			outX.push_back(px[pairs[s][0]]);
+			outY.push_back(py[pairs[s][0]]);
+			outX.push_back(px[pairs[s][1]]);
+			outY.push_back(py[pairs[s][1]]);
+			outX.push_back(NAN);
+			outY.push_back(NAN);
+		}
+	}
+
+	return status;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "RpnBatch.h"
+#include "RpnInterval.h"
+#include "ViewWindow.h"
+
+// Traces the curve where an equation of x and y is zero. The screen is split into a quadtree;
+// cells where interval arithmetic proves the equation can't change sign are dropped, and only
+// the cells left at the smallest size have their corners evaluated and go through marching
+// squares. The work grows with the length of the curve rather than the area of the screen.
+class ImplicitPlotter
+{
+public:
+	static constexpr int ROOT_SIZE = 64; // in pixels
+	static constexpr int LEAF_SIZE = 4;
+	static constexpr int MAX_LEAVES = 8192;
+
+private:
+	struct Cell
+	{
+		s16 x, y; // top left corner in pixels
+	};
+
+	RpnBatch batch;
+	RpnInterval interval;
+	std::vector<Cell> cells, next;
+	std::vector<float> xs, ys, values;
+
+	void Subdivide(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, int size);
+
+public:
+	// Writes the curve as separate segments in graph coordinates: each one is a pair of points
+	// followed by a NaN point, so it can be drawn like a parametric curve with breaks.
+	RpnInstruction::Status Plot(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY);
+};
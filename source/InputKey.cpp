@@ -0,0 +1,34 @@
+#include "InputKey.h"
+
+static constexpr u32 FNV_OFFSET = 2166136261u;
+static constexpr u32 FNV_PRIME = 16777619u;
+
+InputKey::InputKey()
+{
+	hash = FNV_OFFSET;
+}
+
+void InputKey::Clear()
+{
+	bytes.clear();
+	hash = FNV_OFFSET;
+}
+
+void InputKey::Add(const void *data, std::size_t size)
+{
+	const u8 *in = (const u8*)data;
+	bytes.insert(bytes.end(), in, in + size);
+	for (std::size_t i=0; i<size; i++) {
+		hash = (hash ^ in[i]) * FNV_PRIME;
+	}
+}
+
+void InputKey::Add(const InputKey &key)
+{
+	Add(key.bytes.data(), key.bytes.size());
+}
+
+bool InputKey::operator==(const InputKey &other) const
+{
+	return hash == other.hash && bytes == other.bytes;
+}
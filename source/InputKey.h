@@ -0,0 +1,23 @@
+#pragma once
+#include <3ds.h>
+#include <cstddef>
+#include <vector>
+
+// The inputs a cached result was computed from (an equation's revision, the values it read, the
+// view...), kept byte for byte. Keys compare by an FNV-1a hash of the bytes first, and by the
+// bytes themselves only if the hashes match, so a collision can't keep a stale result.
+class InputKey
+{
+	std::vector<u8> bytes;
+	u32 hash;
+	
+public:
+	InputKey();
+	
+	void Clear();
+	void Add(const void *data, std::size_t size);
+	void Add(const InputKey &key);
+	
+	bool operator==(const InputKey &other) const;
+	bool operator!=(const InputKey &other) const { return !(*this == other); }
+};
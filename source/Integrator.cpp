@@ -0,0 +1,137 @@
+#include "Integrator.h"
+#include <algorithm>
+#include <cmath>
+
+// Kronrod nodes on [-1, 1], from the ends to the middle (the other half is mirrored), and
+// their weights. The ones at odd indices and the middle one are also the Gauss nodes, with
+// gaussWeights.
+static const float kronrodNodes[8] = {
+	0.991455371f, 0.949107912f, 0.864864423f, 0.741531186f, 0.586087235f, 0.405845151f, 0.207784955f, 0.0f
+};
+static const float kronrodWeights[8] = {
+	0.022935322f, 0.063092093f, 0.104790010f, 0.140653260f, 0.169004727f, 0.190350578f, 0.204432940f, 0.209482141f
+};
+static const float gaussWeights[4] = { 0.129484966f, 0.279705391f, 0.381830051f, 0.417959184f };
+
+static constexpr int POINTS = 15;
+
+// Allowed error, relative to the larger of the integral and the integral of |f|
+static constexpr float tolerance = 1e-5f;
+
+// Evaluates the rule on every pending interval; false if the program is undefined anywhere
+bool Integrator::EvaluatePending(const RpnEnvironment &env)
+{
+	int n = pending.size() * POINTS;
+	xs.resize(n);
+	ys.resize(n);
+	for (std::size_t i=0; i<pending.size(); i++) {
+		float centre = (pending[i].a + pending[i].b) / 2, half = (pending[i].b - pending[i].a) / 2;
+		float *x = &xs[i * POINTS];
+		for (int k=0; k<7; k++) {
+			x[2 * k] = centre - half * kronrodNodes[k];
+			x[2 * k + 1] = centre + half * kronrodNodes[k];
+		}
+		x[14] = centre;
+	}
+	
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = &xs[0];
+	batch.Evaluate(env, lanes, n, &ys[0]);
+	
+	for (std::size_t i=0; i<pending.size(); i++) {
+		Interval &interval = pending[i];
+		const float *y = &ys[i * POINTS];
+		float kronrod = kronrodWeights[7] * y[14], gauss = gaussWeights[3] * y[14];
+		float absValue = kronrodWeights[7] * std::abs(y[14]);
+		for (int k=0; k<7; k++) {
+			float pair = y[2 * k] + y[2 * k + 1];
+			kronrod += kronrodWeights[k] * pair;
+			absValue += kronrodWeights[k] * (std::abs(y[2 * k]) + std::abs(y[2 * k + 1]));
+			if (k % 2 == 1) {
+				gauss += gaussWeights[k / 2] * pair;
+			}
+		}
+		
+		float half = (interval.b - interval.a) / 2;
+		interval.value = kronrod * half;
+		interval.error = std::abs((kronrod - gauss) * half);
+		interval.absValue = absValue * std::abs(half);
+		if (!std::isfinite(interval.value) || !std::isfinite(interval.error)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+RpnInstruction::Status Integrator::Integrate(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, float a, float b, float &value, float &error)
+{
+	value = error = 0.0f;
+	RpnInstruction::Status status = batch.Compile(program);
+	if (status != RpnInstruction::S_OK || a == b) {
+		return status;
+	}
+	if (!std::isfinite(a) || !std::isfinite(b)) {
+		return RpnInstruction::S_UNDEFINED;
+	}
+	
+	intervals.clear();
+	pending.clear();
+	for (int i=0; i<INITIAL_INTERVALS; i++) {
+		float from = a + (b - a) * i / INITIAL_INTERVALS;
+		float to = (i == INITIAL_INTERVALS - 1) ? b : a + (b - a) * (i + 1) / INITIAL_INTERVALS;
+		pending.push_back(Interval{ from, to, 0.0f, 0.0f, 0.0f });
+	}
+	
+	while (!pending.empty()) {
+		if (!EvaluatePending(env)) {
+			return RpnInstruction::S_UNDEFINED;
+		}
+		intervals.insert(intervals.end(), pending.begin(), pending.end());
+		pending.clear();
+		
+		float absValue = 0.0f;
+		value = error = 0.0f;
+		for (const Interval &interval : intervals) {
+			value += interval.value;
+			error += interval.error;
+			absValue += interval.absValue;
+		}
+		float allowed = tolerance * std::max(std::abs(value), absValue);
+		if (error <= allowed) {
+			break;
+		}
+		
+		// Halve the intervals with more than their share of the allowed error, worst first,
+		// as many as there's room for
+		std::sort(intervals.begin(), intervals.end(), [](const Interval &p, const Interval &q) {
+			return p.error > q.error;
+		});
+		std::size_t kept = 0;
+		for (std::size_t i=0; i<intervals.size(); i++) {
+			const Interval &interval = intervals[i];
+			float share = allowed * std::abs((interval.b - interval.a) / (b - a));
+			float middle = (interval.a + interval.b) / 2;
+			bool room = intervals.size() + pending.size() / 2 < MAX_INTERVALS;
+			if (interval.error > share && room && middle != interval.a && middle != interval.b) {
+				pending.push_back(Interval{ interval.a, middle, 0.0f, 0.0f, 0.0f });
+				pending.push_back(Interval{ middle, interval.b, 0.0f, 0.0f, 0.0f });
+			} else {
+				intervals[kept++] = interval;
+			}
+		}
+		intervals.resize(kept);
+	}
+	
+	return RpnInstruction::S_OK;
+}
+
+void Integrator::RunningIntegral(const float *xs, const float *samples, int count, int anchor, float anchorValue, float *out)
+{
+	out[anchor] = anchorValue;
+	for (int i=anchor+1; i<count; i++) {
+		out[i] = out[i - 1] + (samples[i - 1] + samples[i]) * (xs[i] - xs[i - 1]) / 2;
+	}
+	for (int i=anchor-1; i>=0; i--) {
+		out[i] = out[i + 1] - (samples[i] + samples[i + 1]) * (xs[i + 1] - xs[i]) / 2;
+	}
+}
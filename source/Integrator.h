@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "RpnBatch.h"
+
+// Definite integrals of an equation of x. The range is split into intervals, each integrated
+// with the 15-point Gauss-Kronrod rule, whose difference from the 7-point Gauss rule on the
+// same points estimates its error. Intervals with more than their share of the allowed error
+// are halved, and every round of new intervals is evaluated in one batch.
+class Integrator
+{
+public:
+	static constexpr int INITIAL_INTERVALS = 8;
+	static constexpr int MAX_INTERVALS = 256;
+	
+private:
+	struct Interval
+	{
+		float a, b;
+		float value, error;
+		float absValue; // integral of |f|, for the scale of rounding errors
+	};
+	
+	RpnBatch batch;
+	std::vector<Interval> intervals, pending;
+	std::vector<float> xs, ys;
+	
+	bool EvaluatePending(const RpnEnvironment &env);
+	
+public:
+	// Integral of the program from a to b (b may be less than a) and an estimate of its error,
+	// which is left larger than asked for if the intervals run out. Undefined if the program is
+	// undefined anywhere the rule evaluates it. Plot references are undefined, since the other
+	// plots are only known at the screen columns.
+	RpnInstruction::Status Integrate(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, float a, float b, float &value, float &error);
+	
+	// Running integral over the columns, from the trapezoids between neighbouring samples:
+	// out[anchor] is anchorValue and every other column adds up the samples towards it, so the
+	// whole curve costs one pass. Columns past an undefined sample are undefined.
+	static void RunningIntegral(const float *xs, const float *samples, int count, int anchor, float anchorValue, float *out);
+};
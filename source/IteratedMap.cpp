@@ -0,0 +1,108 @@
+#include "IteratedMap.h"
+#include <algorithm>
+#include <cmath>
+
+IteratedMap::IteratedMap()
+{
+	done = 0;
+	maxCount = 0;
+	texture = nullptr;
+	textureValid = false;
+	counts.assign(COLUMNS * ROWS, 0);
+}
+
+IteratedMap::~IteratedMap()
+{
+	if (texture != nullptr) {
+		sf2d_free_texture(texture);
+	}
+}
+
+// Shades each pixel with the plot's color, more opaque the more iterates landed on it
+void IteratedMap::UpdateTexture(u32 color)
+{
+	if (texture == nullptr) {
+		texture = sf2d_create_texture(COLUMNS, ROWS, TEXFMT_RGBA8, SF2D_PLACE_RAM);
+		if (texture == nullptr) {
+			return;
+		}
+	}
+
+	// Square root, so the rarely visited parts of a chaotic band still show
+	static u8 alphaForLevel[256];
+	if (alphaForLevel[255] == 0) {
+		for (int i=0; i<256; i++) {
+			alphaForLevel[i] = (u8)(std::sqrt(i / 255.0f) * 0xFF);
+		}
+	}
+
+	pixels.resize(COLUMNS * ROWS);
+	u32 scale = (maxCount > 0) ? (255u << 16) / maxCount : 0;
+	u32 rgb = color & 0x00FFFFFF;
+	for (int i=0; i<COLUMNS * ROWS; i++) {
+		u32 level = (counts[i] * scale) >> 16;
+		pixels[i] = rgb | ((u32)alphaForLevel[level] << 24);
+	}
+
+	sf2d_fill_texture_from_RGBA8(texture, &pixels[0], COLUMNS, ROWS);
+	textureValid = true;
+}
+
+RpnInstruction::Status IteratedMap::Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view, const float *columnX, u32 color)
+{
+	if (key != this->key || batch.GetStatus() != RpnInstruction::S_OK) {
+		this->key = key;
+		done = 0;
+		maxCount = 0;
+		textureValid = false;
+		std::fill(state, state + COLUMNS, 0.5f);
+		std::fill(counts.begin(), counts.end(), 0);
+		if (batch.Compile(program) != RpnInstruction::S_OK) {
+			return batch.GetStatus();
+		}
+	}
+	if (done >= WARMUP + ITERATIONS) {
+		return RpnInstruction::S_OK;
+	}
+
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = columnX;
+
+	if (done < WARMUP) {
+		// Nothing is counted yet, so there's no need to keep the iterates
+		int count = std::min(WARMUP - done, ITERATIONS_PER_FRAME);
+		batch.Iterate(env, lanes, COLUMNS, RpnEnvironment::VAR_Y, state, count);
+		done += count;
+		return RpnInstruction::S_OK;
+	}
+
+	int count = std::min(WARMUP + ITERATIONS - done, ITERATIONS_PER_FRAME);
+	history.resize(count * COLUMNS);
+	rows.resize(count * COLUMNS);
+	batch.Iterate(env, lanes, COLUMNS, RpnEnvironment::VAR_Y, state, count, &history[0]);
+	done += count;
+
+	view.MapToScreenY(&history[0], &rows[0], count * COLUMNS);
+	for (int k=0; k<count; k++) {
+		const s32 *row = &rows[k * COLUMNS];
+		for (int i=0; i<COLUMNS; i++) {
+			if (row[i] >= 0 && row[i] < ROWS) {
+				u16 &c = counts[row[i] * COLUMNS + i];
+				if (c < 0xFFFF) {
+					++c;
+				}
+				maxCount = std::max(maxCount, c);
+			}
+		}
+	}
+
+	UpdateTexture(color);
+	return RpnInstruction::S_OK;
+}
+
+void IteratedMap::Draw() const
+{
+	if (textureValid) {
+		sf2d_draw_texture(texture, 0, 0);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <3ds.h>
+#include <sf2d.h>
+#include <vector>
+#include "InputKey.h"
+#include "RpnBatch.h"
+#include "ViewWindow.h"
+
+// Bifurcation diagram of a map y -> f(x, y), with x as the parameter. Every screen column
+// iterates the map from y = 0.5; after a warm-up, each iterate adds to the count of the pixel
+// it lands on, and the counts are shown as a density. A few iterations run each frame, so the
+// diagram sharpens while it's on screen instead of stalling the frame it's asked for.
+class IteratedMap
+{
+public:
+	static constexpr int COLUMNS = 400;
+	static constexpr int ROWS = 240;
+	static constexpr int WARMUP = 256;
+	static constexpr int ITERATIONS = 2048; // counted ones, after the warm-up
+	static constexpr int ITERATIONS_PER_FRAME = 64;
+
+private:
+	RpnBatch batch;
+	InputKey key;
+	int done; // iterations so far, including the warm-up
+	float state[COLUMNS];
+	std::vector<float> history;
+	std::vector<s32> rows;
+	std::vector<u16> counts;
+	u16 maxCount;
+	std::vector<u32> pixels;
+	sf2d_texture *texture;
+	bool textureValid;
+
+	void UpdateTexture(u32 color);
+
+public:
+	IteratedMap();
+	~IteratedMap();
+	IteratedMap(const IteratedMap&) = delete;
+	IteratedMap &operator=(const IteratedMap&) = delete;
+
+	// Starts over if key (the program's inputs: the variables, the view...) changed, and runs
+	// this frame's share of the iterations otherwise. columnX holds the x of every column.
+	RpnInstruction::Status Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view, const float *columnX, u32 color);
+	void Draw() const;
+};
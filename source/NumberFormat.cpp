@@ -0,0 +1,193 @@
+#include "NumberFormat.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Up to 10^9, float * 10^n is still exact in a double, so rounding it gives the same result
+// printf would get from the exact decimal expansion.
+static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+// Every power of ten FormatShortest can need, from scaling up the smallest denormal to nine
+// significant digits, to scaling down the largest float.
+static const double widePowersOf10[] = {
+	1e-53, 1e-52, 1e-51, 1e-50, 1e-49, 1e-48, 1e-47, 1e-46, 1e-45,
+	1e-44, 1e-43, 1e-42, 1e-41, 1e-40, 1e-39, 1e-38, 1e-37, 1e-36,
+	1e-35, 1e-34, 1e-33, 1e-32, 1e-31, 1e-30, 1e-29, 1e-28, 1e-27,
+	1e-26, 1e-25, 1e-24, 1e-23, 1e-22, 1e-21, 1e-20, 1e-19, 1e-18,
+	1e-17, 1e-16, 1e-15, 1e-14, 1e-13, 1e-12, 1e-11, 1e-10, 1e-9,
+	1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0,
+	1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+	1e19, 1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27,
+	1e28, 1e29, 1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36,
+	1e37, 1e38, 1e39, 1e40, 1e41, 1e42, 1e43, 1e44, 1e45,
+	1e46, 1e47, 1e48, 1e49, 1e50, 1e51, 1e52, 1e53
+};
+
+static inline double Pow10(int n)
+{
+	return widePowersOf10[n + 53];
+}
+
+static int CopyOut(char *out, int size, const char *str, int length)
+{
+	if (size <= 0) return 0;
+	if (length > size - 1) length = size - 1;
+	std::memcpy(out, str, length);
+	out[length] = '\0';
+	return length;
+}
+
+// Writes the decimal digits of n into the end of buf and returns a pointer to the first one.
+// At least minDigits digits are written, padding with leading zeros.
+static char *WriteDigits(char *bufEnd, unsigned long long n, int minDigits)
+{
+	char *p = bufEnd;
+	int count = 0;
+	
+	// 64-bit division is a library call on the 3DS, so switch to 32 bits as soon as possible.
+	while (n > 0xFFFFFFFFull) {
+		*--p = '0' + (int)(n % 10);
+		n /= 10;
+		++count;
+	}
+	
+	unsigned int n32 = (unsigned int)n;
+	do {
+		*--p = '0' + n32 % 10;
+		n32 /= 10;
+		++count;
+	} while (n32 > 0 || count < minDigits);
+	
+	return p;
+}
+
+static int FormatSpecial(char *out, int size, float value)
+{
+	if (std::isnan(value)) {
+		return CopyOut(out, size, std::signbit(value) ? "-nan" : "nan", std::signbit(value) ? 4 : 3);
+	} else {
+		return CopyOut(out, size, std::signbit(value) ? "-inf" : "inf", std::signbit(value) ? 4 : 3);
+	}
+}
+
+int FormatFixed(char *out, int size, float value, int precision)
+{
+	if (precision < 0) precision = 0;
+	if (precision > 9) precision = 9;
+	
+	if (!std::isfinite(value)) {
+		return FormatSpecial(out, size, value);
+	}
+	
+	double scaled = std::nearbyint(std::fabs((double)value) * powersOf10[precision]);
+	if (scaled >= 1.8e19) {
+		// Too big for the integer path; this is rare enough to leave to snprintf.
+		char buf[64];
+		int length = std::snprintf(buf, sizeof(buf), "%.*f", precision, value);
+		return CopyOut(out, size, buf, length);
+	}
+	
+	char buf[32];
+	char *end = buf + sizeof(buf);
+	char *p = WriteDigits(end, (unsigned long long)scaled, precision + 1);
+	
+	if (precision > 0) {
+		// Shift the integer part left by one to make room for the decimal point.
+		char *point = end - precision;
+		std::memmove(p - 1, p, point - p);
+		--p;
+		point[-1] = '.';
+	}
+	
+	if (std::signbit(value)) {
+		*--p = '-';
+	}
+	
+	return CopyOut(out, size, p, end - p);
+}
+
+int FormatShortest(char *out, int size, float value)
+{
+	if (!std::isfinite(value)) {
+		return FormatSpecial(out, size, value);
+	}
+	
+	if (value == 0.0f) {
+		return CopyOut(out, size, std::signbit(value) ? "-0" : "0", std::signbit(value) ? 2 : 1);
+	}
+	
+	double a = std::fabs((double)value);
+	int binaryExponent;
+	std::frexp(a, &binaryExponent);
+	int exponent = (int)std::floor((binaryExponent - 1) * 0.30103);
+	while (Pow10(exponent) > a) --exponent;
+	while (Pow10(exponent + 1) <= a) ++exponent;
+	
+	// Find the fewest significant digits that still convert back to the same float. Nine is
+	// always enough for a float.
+	unsigned long long mantissa = 0;
+	int digits;
+	for (digits = 1; digits <= 9; ++digits) {
+		int scale = exponent - digits + 1;
+		double m = (scale < 0) ? std::nearbyint(a * Pow10(-scale)) : std::nearbyint(a / Pow10(scale));
+		double back = (scale < 0) ? m / Pow10(-scale) : m * Pow10(scale);
+		if ((float)back == (float)a) {
+			mantissa = (unsigned long long)m;
+			break;
+		}
+	}
+	if (digits > 9) {
+		digits = 9;
+		int scale = exponent - 8;
+		mantissa = (unsigned long long)((scale < 0) ? std::nearbyint(a * Pow10(-scale)) : std::nearbyint(a / Pow10(scale)));
+	}
+	
+	// Rounding up can carry into a new digit (9.99 -> 10.0).
+	if (mantissa >= (unsigned long long)powersOf10[digits]) {
+		mantissa /= 10;
+		++exponent;
+	}
+	
+	while (digits > 1 && mantissa % 10 == 0) {
+		mantissa /= 10;
+		--digits;
+	}
+	
+	char digitBuf[16];
+	char *digitEnd = digitBuf + sizeof(digitBuf);
+	char *d = WriteDigits(digitEnd, mantissa, digits);
+	
+	char buf[32];
+	char *p = buf;
+	if (value < 0) *p++ = '-';
+	
+	if (exponent >= -5 && exponent < 10) {
+		if (exponent < 0) {
+			*p++ = '0';
+			*p++ = '.';
+			for (int i=-1; i>exponent; --i) *p++ = '0';
+			for (int i=0; i<digits; ++i) *p++ = d[i];
+		} else {
+			for (int i=0; i<=exponent; ++i) *p++ = (i < digits) ? d[i] : '0';
+			if (digits > exponent + 1) {
+				*p++ = '.';
+				for (int i=exponent+1; i<digits; ++i) *p++ = d[i];
+			}
+		}
+	} else {
+		*p++ = d[0];
+		if (digits > 1) {
+			*p++ = '.';
+			for (int i=1; i<digits; ++i) *p++ = d[i];
+		}
+		*p++ = 'e';
+		*p++ = (exponent < 0) ? '-' : '+';
+		int e = std::abs(exponent);
+		if (e >= 10) *p++ = '0' + e / 10;
+		else *p++ = '0';
+		*p++ = '0' + e % 10;
+	}
+	
+	return CopyOut(out, size, buf, p - buf);
+}
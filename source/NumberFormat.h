@@ -0,0 +1,12 @@
+#pragma once
+
+// Number to text conversion for things that are redrawn every frame. Both functions write a
+// NUL-terminated string into caller-provided storage, never allocate, and return the length
+// of the string written (which is truncated to fit if the buffer is too small).
+
+// Like printf's "%.*f", including rounding. precision is clamped to 0-9.
+int FormatFixed(char *out, int size, float value, int precision);
+
+// The shortest decimal string that reads back as exactly the same float, in plain notation
+// for moderate exponents and "1.5e-07" style otherwise.
+int FormatShortest(char *out, int size, float value);
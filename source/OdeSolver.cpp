@@ -0,0 +1,212 @@
+#include "OdeSolver.h"
+#include <algorithm>
+#include <cmath>
+
+// Cash-Karp coefficients: where each stage is evaluated, how it combines the earlier stages,
+// and the fifth and fourth order weights whose difference estimates the error
+static const float stageC[6] = { 0.0f, 1.0f / 5, 3.0f / 10, 3.0f / 5, 1.0f, 7.0f / 8 };
+static const float stageA[6][5] = {
+	{ 0 },
+	{ 1.0f / 5 },
+	{ 3.0f / 40, 9.0f / 40 },
+	{ 3.0f / 10, -9.0f / 10, 6.0f / 5 },
+	{ -11.0f / 54, 5.0f / 2, -70.0f / 27, 35.0f / 27 },
+	{ 1631.0f / 55296, 175.0f / 512, 575.0f / 13824, 44275.0f / 110592, 253.0f / 4096 }
+};
+static const float weight5[6] = { 37.0f / 378, 0.0f, 250.0f / 621, 125.0f / 594, 0.0f, 512.0f / 1771 };
+static const float weight4[6] = { 2825.0f / 27648, 0.0f, 18575.0f / 48384, 13525.0f / 55296, 277.0f / 14336, 1.0f / 4 };
+
+// Largest error allowed in one step, and the longest step, in pixels
+static constexpr float tolerance = 0.1f;
+static constexpr float maxStepX = 4.0f;
+static constexpr float maxStepY = 6.0f;
+
+RpnInstruction::Status OdeSolver::SlopeField(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY)
+{
+	outX.clear();
+	outY.clear();
+
+	RpnInstruction::Status status = batch.Compile(program);
+	if (status != RpnInstruction::S_OK) {
+		return status;
+	}
+
+	xs.clear();
+	ys.clear();
+	for (int sy=FIELD_SPACING/2; sy<240; sy+=FIELD_SPACING) {
+		for (int sx=FIELD_SPACING/2; sx<400; sx+=FIELD_SPACING) {
+			Point<float> p = view.GetGraphCoords(sx, sy);
+			xs.push_back(p.x);
+			ys.push_back(p.y);
+		}
+	}
+
+	int n = xs.size();
+	k[0].resize(n);
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = &xs[0];
+	lanes[RpnEnvironment::VAR_Y] = &ys[0];
+	batch.Evaluate(env, lanes, n, &k[0][0]);
+
+	// Pixels per graph unit, with y going up
+	float scaleX = 399 / (view.xmax - view.xmin);
+	float scaleY = 239 / (view.ymax - view.ymin);
+	const float halfLength = FIELD_SPACING * 0.3f;
+
+	for (int i=0; i<n; i++) {
+		float slope = k[0][i];
+		float ux, uy; // direction of the mark on the screen
+		if (std::isinf(slope)) {
+			ux = 0.0f;
+			uy = 1.0f;
+		} else if (std::isnan(slope)) {
+			continue;
+		} else {
+			ux = scaleX;
+			uy = slope * scaleY;
+			float length = std::sqrt(ux * ux + uy * uy);
+			if (!(length > 0) || !std::isfinite(length)) {
+				ux = 0.0f;
+				uy = 1.0f;
+			} else {
+				ux /= length;
+				uy /= length;
+			}
+		}
+
+		float dx = halfLength * ux / scaleX, dy = halfLength * uy / scaleY;
+		outX.push_back(xs[i] - dx);
+		outY.push_back(ys[i] - dy);
+		outX.push_back(xs[i] + dx);
+		outY.push_back(ys[i] + dy);
+		outX.push_back(NAN);
+		outY.push_back(NAN);
+	}
+
+	return status;
+}
+
+// Evaluates one stage of the current step for every active lane in one batch
+void OdeSolver::EvaluateStage(int stage, const RpnEnvironment &env)
+{
+	int n = active.size();
+	xs.resize(n);
+	ys.resize(n);
+	k[stage].resize(n);
+
+	for (int i=0; i<n; i++) {
+		const Lane &lane = lanes[active[i]];
+		float dy = 0.0f;
+		for (int j=0; j<stage; j++) {
+			dy += stageA[stage][j] * k[j][i];
+		}
+		xs[i] = lane.x + stageC[stage] * lane.h;
+		ys[i] = lane.y + lane.h * dy;
+	}
+
+	const float *slots[RpnEnvironment::SLOT_COUNT] = {};
+	slots[RpnEnvironment::VAR_X] = &xs[0];
+	slots[RpnEnvironment::VAR_Y] = &ys[0];
+	batch.Evaluate(env, slots, n, &k[stage][0]);
+}
+
+RpnInstruction::Status OdeSolver::Solve(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, const std::vector<float> &startX, const std::vector<float> &startY, std::vector<float> &outX, std::vector<float> &outY)
+{
+	outX.clear();
+	outY.clear();
+
+	RpnInstruction::Status status = batch.Compile(program);
+	if (status != RpnInstruction::S_OK || startX.empty()) {
+		return status;
+	}
+
+	float scaleX = 399 / (view.xmax - view.xmin);
+	float scaleY = 239 / (view.ymax - view.ymin);
+	float hMax = maxStepX / scaleX;
+	float hMin = hMax / 1024;
+	float yLimit = 240 / scaleY; // how far past the top or bottom edge a curve is followed
+
+	// Lanes 2i and 2i + 1 go forwards and backwards from start i
+	lanes.resize(startX.size() * 2);
+	active.clear();
+	for (std::size_t i=0; i<lanes.size(); i++) {
+		Lane &lane = lanes[i];
+		bool forwards = (i % 2 == 0);
+		lane.x = startX[i / 2];
+		lane.y = startY[i / 2];
+		lane.h = forwards ? hMax : -hMax;
+		lane.end = forwards ? view.xmax + hMax : view.xmin - hMax;
+		lane.steps = 0;
+		lane.pathX.assign(1, lane.x);
+		lane.pathY.assign(1, lane.y);
+		if (std::isfinite(lane.x) && std::isfinite(lane.y)) {
+			active.push_back(i);
+		}
+	}
+
+	while (!active.empty()) {
+		for (int s=0; s<STAGES; s++) {
+			EvaluateStage(s, env);
+		}
+
+		std::size_t kept = 0;
+		for (std::size_t i=0; i<active.size(); i++) {
+			Lane &lane = lanes[active[i]];
+			float slope = 0.0f, error = 0.0f;
+			for (int s=0; s<STAGES; s++) {
+				slope += weight5[s] * k[s][i];
+				error += (weight5[s] - weight4[s]) * k[s][i];
+			}
+			float y = lane.y + lane.h * slope;
+			float errorPixels = std::abs(lane.h * error) * scaleY;
+			float movePixels = std::abs(y - lane.y) * scaleY;
+			bool small = std::abs(lane.h) <= hMin;
+			bool done = false;
+
+			if (!std::isfinite(y) || !std::isfinite(errorPixels)) {
+				// Either a step too long for a steep part, or the solution is undefined here
+				done = small;
+				lane.h = std::max(std::abs(lane.h) / 4, hMin) * (lane.h < 0 ? -1 : 1);
+			} else {
+				if (errorPixels <= tolerance && movePixels <= maxStepY) {
+					lane.x += lane.h;
+					lane.y = y;
+					lane.pathX.push_back(lane.x);
+					lane.pathY.push_back(lane.y);
+					++lane.steps;
+					done = (lane.h > 0) ? lane.x >= lane.end : lane.x <= lane.end;
+					done = done || lane.y > view.ymax + yLimit || lane.y < view.ymin - yLimit || lane.steps >= MAX_STEPS;
+				} else if (small) {
+					done = true; // the solution turns vertical, e.g. where it ends on a singularity
+				}
+
+				float factor = (errorPixels > 0) ? 0.9f * std::pow(tolerance / errorPixels, 0.2f) : 5.0f;
+				if (movePixels > 0) {
+					factor = std::min(factor, 0.9f * maxStepY / movePixels);
+				}
+				factor = std::max(0.2f, std::min(5.0f, factor));
+				float h = std::max(hMin, std::min(hMax, std::abs(lane.h) * factor));
+				lane.h = (lane.h < 0) ? -h : h;
+			}
+
+			if (!done) {
+				active[kept++] = active[i];
+			}
+		}
+		active.resize(kept);
+	}
+
+	for (std::size_t i=0; i<lanes.size(); i+=2) {
+		const Lane &forwards = lanes[i], &backwards = lanes[i + 1];
+		for (std::size_t p=backwards.pathX.size(); p-->1; ) {
+			outX.push_back(backwards.pathX[p]);
+			outY.push_back(backwards.pathY[p]);
+		}
+		outX.insert(outX.end(), forwards.pathX.begin(), forwards.pathX.end());
+		outY.insert(outY.end(), forwards.pathY.begin(), forwards.pathY.end());
+		outX.push_back(NAN);
+		outY.push_back(NAN);
+	}
+
+	return status;
+}
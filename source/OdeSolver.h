@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include "RpnBatch.h"
+#include "ViewWindow.h"
+
+// Draws the solutions of dy/dx = f(x, y), where f is an equation of x and y. The slope field is
+// a grid of short marks with the slope at their centre. Solution curves are integrated with the
+// Cash-Karp RK45 method, with the error of each step kept under a fraction of a pixel. Every
+// curve, forwards and backwards from its starting point, advances in lockstep with the others,
+// so each stage of a step is one batch evaluation for all of them, each with its own step size.
+class OdeSolver
+{
+public:
+	static constexpr int FIELD_SPACING = 20; // pixels between slope marks
+	static constexpr int MAX_STEPS = 1000; // per curve and direction
+
+private:
+	static constexpr int STAGES = 6;
+
+	struct Lane
+	{
+		float x, y, h; // h is negative going backwards
+		float end; // x where the curve leaves the screen
+		int steps;
+		std::vector<float> pathX, pathY;
+	};
+
+	RpnBatch batch;
+	std::vector<Lane> lanes;
+	std::vector<int> active;
+	std::vector<float> xs, ys, k[STAGES];
+
+	void EvaluateStage(int stage, const RpnEnvironment &env);
+
+public:
+	// Writes the marks as separate segments with a NaN point after each, like ImplicitPlotter
+	RpnInstruction::Status SlopeField(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, std::vector<float> &outX, std::vector<float> &outY);
+
+	// Writes one curve through each starting point, with a NaN point after each curve
+	RpnInstruction::Status Solve(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const ViewWindow &view, const std::vector<float> &startX, const std::vector<float> &startY, std::vector<float> &outX, std::vector<float> &outY);
+};
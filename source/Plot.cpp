@@ -0,0 +1,73 @@
+#include "Plot.h"
+#include <algorithm>
+#include <cmath>
+
+Plot::Plot(u32 color)
+{
+	type = T_FUNCTION;
+	tMin = 0.0f;
+	tMax = 6.2831853f;
+	integralFrom = NAN;
+	revision = 0;
+	this->color = color;
+	std::fill(samples, samples + COLUMNS, NAN);
+	sampleMin = 1.0f;
+	sampleMax = -1.0f;
+	curveXMin = 1.0f;
+	curveXMax = -1.0f;
+	status = RpnInstruction::S_UNDERFLOW;
+	samplesValid = false;
+}
+
+void Plot::Edited()
+{
+	++revision;
+}
+
+void Plot::UpdateBounds()
+{
+	sampleMin = curveXMin = INFINITY;
+	sampleMax = curveXMax = -INFINITY;
+	
+	if (type == T_FUNCTION || type == T_INTEGRAL) {
+		for (int i=0; i<COLUMNS; i++) {
+			if (std::isfinite(samples[i])) {
+				sampleMin = std::min(sampleMin, samples[i]);
+				sampleMax = std::max(sampleMax, samples[i]);
+			}
+		}
+	} else {
+		for (std::size_t i=0; i<curveX.size(); i++) {
+			if (std::isfinite(curveX[i]) && std::isfinite(curveY[i])) {
+				curveXMin = std::min(curveXMin, curveX[i]);
+				curveXMax = std::max(curveXMax, curveX[i]);
+				sampleMin = std::min(sampleMin, curveY[i]);
+				sampleMax = std::max(sampleMax, curveY[i]);
+			}
+		}
+	}
+}
+
+bool Plot::IsVisible(const ViewWindow &view) const
+{
+	if (status != RpnInstruction::S_OK) {
+		return false;
+	}
+	if (type == T_ODE) {
+		return true; // the slope field covers the screen
+	}
+	if (sampleMin > sampleMax) {
+		return false;
+	}
+	
+	// Lines are 2 pixels wide, so allow for a pixel past the edges
+	float margin = (view.ymax - view.ymin) / 240;
+	if (sampleMax < view.ymin - margin || sampleMin > view.ymax + margin) {
+		return false;
+	}
+	if (type != T_FUNCTION && type != T_INTEGRAL) {
+		margin = (view.xmax - view.xmin) / 400;
+		return curveXMax >= view.xmin - margin && curveXMin <= view.xmax + margin;
+	}
+	return true;
+}
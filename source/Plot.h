@@ -0,0 +1,53 @@
+#pragma once
+#include <3ds.h>
+#include <memory>
+#include <vector>
+#include "Heatmap.h"
+#include "InputKey.h"
+#include "IteratedMap.h"
+#include "PlotLayer.h"
+#include "RpnInstruction.h"
+#include "SurfacePlot.h"
+#include "ViewWindow.h"
+
+// One entry of the plot list: the equation and everything cached for drawing it
+class Plot
+{
+public:
+	static constexpr int COLUMNS = 400;
+	
+	enum Type { T_FUNCTION, T_PARAMETRIC, T_POLAR, T_IMPLICIT, T_HEATMAP, T_ODE, T_ITERATED, T_INTEGRAL, T_COMPLEX, T_SURFACE };
+	
+	Type type;
+	float tMin, tMax; // range of t for parametric and polar plots
+	float integralFrom; // x marked in trace mode, NaN if none; integral plots start there, or at 0
+	std::vector<RpnInstruction> equation;
+	std::vector<RpnInstruction> hoisted; // equation with everything but x evaluated
+	u32 revision; // bumped on every edit
+	u32 color;
+	
+	float samples[COLUMNS]; // value at each screen column (of the integral, for integral plots), NaN where undefined
+	float sampleMin, sampleMax; // range of the finite samples; min > max if there are none
+	std::vector<float> curveX, curveY; // points of parametric, polar and implicit plots, NaN at breaks
+	float curveXMin, curveXMax;
+	std::vector<float> startX, startY; // starting points of the solution curves of ODE plots
+	std::vector<float> fieldX, fieldY; // slope field marks of ODE plots
+	InputKey slopeKey; // view and equation inputs the slope field was computed for
+	RpnInstruction::Status status;
+	InputKey key; // everything the samples depend on, in this frame
+	InputKey fieldKey; // same, leaving out the view, for heatmaps
+	InputKey sampledKey; // key when the samples were computed
+	bool samplesValid;
+	
+	std::unique_ptr<PlotLayer> layer; // only the visible plots get one
+	InputKey layerKey;
+	std::unique_ptr<Heatmap> heatmap; // only for heatmap and complex plots
+	std::unique_ptr<IteratedMap> iterated; // only for iterated map plots
+	std::unique_ptr<SurfacePlot> surface; // only for surface plots
+	
+	Plot(u32 color);
+	
+	void Edited();
+	void UpdateBounds();
+	bool IsVisible(const ViewWindow &view) const;
+};
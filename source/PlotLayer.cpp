@@ -0,0 +1,51 @@
+#include "PlotLayer.h"
+
+PlotLayer::PlotLayer()
+{
+	target = nullptr;
+	valid = false;
+}
+
+PlotLayer::~PlotLayer()
+{
+	if (target != nullptr) {
+		sf2d_free_target(target);
+	}
+}
+
+bool PlotLayer::IsCurrent(const InputKey &key) const
+{
+	return valid && this->key == key;
+}
+
+bool PlotLayer::Begin(const InputKey &key)
+{
+	if (target == nullptr) {
+		target = sf2d_create_rendertarget(400, 240);
+		if (target == nullptr) {
+			return false;
+		}
+	}
+	
+	this->key = key;
+	valid = false;
+	sf2d_clear_target(target, RGBA8(0x00, 0x00, 0x00, 0x00));
+	sf2d_start_frame_target(target);
+	return true;
+}
+
+void PlotLayer::End()
+{
+	sf2d_end_frame();
+	valid = true;
+}
+
+void PlotLayer::Draw() const
+{
+	sf2d_draw_texture(&target->texture, 0, 0);
+}
+
+void PlotLayer::Invalidate()
+{
+	valid = false;
+}
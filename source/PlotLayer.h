@@ -0,0 +1,29 @@
+#pragma once
+#include <3ds.h>
+#include <sf2d.h>
+#include "InputKey.h"
+
+// Off-screen texture holding one plot's curve. The curve is only drawn again when the key it
+// was drawn for changes, and composited onto the top screen every frame otherwise.
+class PlotLayer
+{
+	sf2d_rendertarget *target;
+	InputKey key;
+	bool valid;
+	
+public:
+	PlotLayer();
+	~PlotLayer();
+	
+	PlotLayer(const PlotLayer&) = delete;
+	PlotLayer &operator=(const PlotLayer&) = delete;
+	
+	bool IsCurrent(const InputKey &key) const;
+	
+	// Clears the layer and starts drawing into it, returning false if there's no memory for
+	// it. Must be called outside sf2d_start_frame/sf2d_end_frame, and followed by End.
+	bool Begin(const InputKey &key);
+	void End();
+	void Draw() const;
+	void Invalidate();
+};
@@ -0,0 +1,219 @@
+#include "RpnBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+RpnBatch::RpnBatch()
+{
+	depth = 0;
+	results = 1;
+	status = RpnInstruction::S_UNDERFLOW;
+}
+
+RpnInstruction::Status RpnBatch::Compile(const std::vector<RpnInstruction> &instructions, int results)
+{
+	program = instructions;
+	this->results = results;
+	
+	status = CheckProgram(program, results, depth);
+	if (status == RpnInstruction::S_OK) {
+		stack.resize(depth * LANES);
+	}
+	return status;
+}
+
+RpnInstruction::Status RpnBatch::GetStatus() const
+{
+	return status;
+}
+
+void RpnBatch::Evaluate(const RpnEnvironment &env, const float *const *lanes, int count, float *out, const float *const *plotLanes)
+{
+	Evaluate(env, lanes, count, &out, plotLanes);
+}
+
+void RpnBatch::Evaluate(const RpnEnvironment &env, const float *const *lanes, int count, float *const *outs, const float *const *plotLanes)
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	
+	if (status != RpnInstruction::S_OK) {
+		for (int r=0; r<results; r++) {
+			std::fill(outs[r], outs[r] + count, nan);
+		}
+		return;
+	}
+	
+	for (int start=0; start<count; start+=LANES) {
+		int n = std::min(count - start, (int)LANES);
+		EvaluateBlock(env, lanes, start, n, plotLanes);
+		
+		const float *base = &stack[0];
+		for (int r=0; r<results; r++) {
+			std::copy(base + r * LANES, base + r * LANES + n, outs[r] + start);
+		}
+	}
+}
+
+// Runs the program on lanes start to start + n - 1, leaving result r at stack[r * LANES]
+void RpnBatch::EvaluateBlock(const RpnEnvironment &env, const float *const *lanes, int start, int n, const float *const *plotLanes)
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	float *base = &stack[0];
+	int sp = 0;
+	std::size_t loopBegin = 0;
+	int k = -1, kEnd = 0; // k is -1 outside a loop
+	
+	for (std::size_t pc=0; pc<program.size(); pc++) {
+		const RpnInstruction &inst = program[pc];
+		// a and b are the second and first entries from the top, dest is the free slot above
+		float *a = base + (sp - 2) * LANES;
+		float *b = base + (sp - 1) * LANES;
+		float *dest = base + sp * LANES;
+		
+		switch (inst.op) {
+			case RpnInstruction::OP_PUSH:
+				std::fill(dest, dest + n, inst.value);
+				++sp;
+				break;
+			case RpnInstruction::OP_PUSHVAR:
+				if (inst.slot == RpnEnvironment::VAR_K && k >= 0) {
+					std::fill(dest, dest + n, (float)k);
+				} else if (lanes != nullptr && lanes[inst.slot] != nullptr) {
+					std::copy(lanes[inst.slot] + start, lanes[inst.slot] + start + n, dest);
+				} else {
+					std::fill(dest, dest + n, env.values[inst.slot]);
+				}
+				++sp;
+				break;
+			case RpnInstruction::OP_PUSHPLOT:
+				if (inst.plot < 0 || inst.plot >= env.plotCount) {
+					std::fill(dest, dest + n, nan);
+				} else if (plotLanes != nullptr && plotLanes[inst.plot] != nullptr) {
+					std::copy(plotLanes[inst.plot] + start, plotLanes[inst.plot] + start + n, dest);
+				} else {
+					std::fill(dest, dest + n, (env.plotValues != nullptr) ? env.plotValues[inst.plot] : nan);
+				}
+				++sp;
+				break;
+			case RpnInstruction::OP_ADD:
+				for (int i=0; i<n; i++) a[i] += b[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_SUBTRACT:
+				for (int i=0; i<n; i++) a[i] -= b[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_MULTIPLY:
+				for (int i=0; i<n; i++) a[i] *= b[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_DIVIDE:
+				for (int i=0; i<n; i++) a[i] = (b[i] == 0) ? nan : a[i] / b[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_MODULO:
+				for (int i=0; i<n; i++) a[i] = (b[i] == 0) ? nan : std::fmod(a[i], b[i]);
+				--sp;
+				break;
+			case RpnInstruction::OP_POWER:
+				// pow(NaN, 0) is 1, but an undefined base has to stay undefined
+				for (int i=0; i<n; i++) a[i] = (a[i] != a[i] || b[i] != b[i]) ? nan : std::pow(a[i], b[i]);
+				--sp;
+				break;
+			case RpnInstruction::OP_LESS:
+				for (int i=0; i<n; i++) a[i] = (a[i] != a[i] || b[i] != b[i]) ? nan : (a[i] < b[i]) ? 1.0f : 0.0f;
+				--sp;
+				break;
+			case RpnInstruction::OP_GREATER:
+				for (int i=0; i<n; i++) a[i] = (a[i] != a[i] || b[i] != b[i]) ? nan : (a[i] > b[i]) ? 1.0f : 0.0f;
+				--sp;
+				break;
+			case RpnInstruction::OP_MIN:
+				for (int i=0; i<n; i++) a[i] = (a[i] != a[i] || b[i] != b[i]) ? nan : std::min(a[i], b[i]);
+				--sp;
+				break;
+			case RpnInstruction::OP_MAX:
+				for (int i=0; i<n; i++) a[i] = (a[i] != a[i] || b[i] != b[i]) ? nan : std::max(a[i], b[i]);
+				--sp;
+				break;
+			case RpnInstruction::OP_SELECT: {
+				// Both values are computed for every lane and one is picked, so an undefined one
+				// only matters in the lanes where it's picked
+				float *cond = base + (sp - 3) * LANES;
+				for (int i=0; i<n; i++) cond[i] = (cond[i] != cond[i]) ? nan : (cond[i] != 0) ? a[i] : b[i];
+				sp -= 2;
+				break;
+			}
+			case RpnInstruction::OP_NEGATE:
+				for (int i=0; i<n; i++) b[i] = -b[i];
+				break;
+			case RpnInstruction::OP_FUNCTION:
+				for (int i=0; i<n; i++) b[i] = inst.IsInDomain(b[i]) ? inst.func(b[i]) : nan;
+				break;
+			case RpnInstruction::OP_DUP:
+				std::copy(b, b + n, dest);
+				++sp;
+				break;
+			case RpnInstruction::OP_LOOP: {
+				// The body runs as many times as the longest count in the block (at least once);
+				// the terms past a lane's own count are left out of its result
+				kEnd = 0;
+				for (int i=0; i<n; i++) {
+					loopTerms[i] = (b[i] >= 0 && b[i] <= RpnInstruction::MAX_TERMS) ? (int)b[i] : -1;
+					kEnd = std::max(kEnd, loopTerms[i]);
+				}
+				--sp;
+				loopBegin = pc;
+				k = 0;
+				break;
+			}
+			case RpnInstruction::OP_SUM:
+			case RpnInstruction::OP_PRODUCT:
+				if (k == 0) {
+					float none = (inst.op == RpnInstruction::OP_SUM) ? 0.0f : 1.0f;
+					for (int i=0; i<n; i++) loopResult[i] = (loopTerms[i] < 0) ? nan : (loopTerms[i] > 0) ? b[i] : none;
+				} else if (inst.op == RpnInstruction::OP_SUM) {
+					for (int i=0; i<n; i++) loopResult[i] += (k < loopTerms[i]) ? b[i] : 0.0f;
+				} else {
+					for (int i=0; i<n; i++) loopResult[i] *= (k < loopTerms[i]) ? b[i] : 1.0f;
+				}
+				if (++k < kEnd) {
+					--sp;
+					pc = loopBegin; // back to the start of the body
+				} else {
+					std::copy(loopResult, loopResult + n, b);
+					k = -1;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void RpnBatch::Iterate(const RpnEnvironment &env, const float *const *lanes, int count, int slot, float *state, int iterations, float *history)
+{
+	if (status != RpnInstruction::S_OK) {
+		std::fill(state, state + count, std::numeric_limits<float>::quiet_NaN());
+		return;
+	}
+	
+	const float *iterLanes[RpnEnvironment::SLOT_COUNT] = {};
+	if (lanes != nullptr) {
+		std::copy(lanes, lanes + RpnEnvironment::SLOT_COUNT, iterLanes);
+	}
+	iterLanes[slot] = state;
+	
+	// Each block goes through every iteration before the next one starts, so its lanes and the
+	// stack stay in the cache
+	for (int start=0; start<count; start+=LANES) {
+		int n = std::min(count - start, (int)LANES);
+		for (int k=0; k<iterations; k++) {
+			EvaluateBlock(env, iterLanes, start, n, nullptr);
+			std::copy(&stack[0], &stack[0] + n, state + start);
+			if (history != nullptr) {
+				std::copy(&stack[0], &stack[0] + n, history + k * count + start);
+			}
+		}
+	}
+}
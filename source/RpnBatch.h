@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include "RpnEnvironment.h"
+#include "RpnInstruction.h"
+
+// Evaluates an equation for many values of its variables at once. Each instruction is applied
+// to a whole block of lanes before moving on to the next one, instead of running the whole
+// program once per value. Stack overflow and underflow don't depend on the values, so they are
+// found once by Compile. A lane whose value is undefined comes out as NaN. A sum or product loop
+// runs its body over the whole block for each k, so its terms cost no more than written out.
+class RpnBatch
+{
+public:
+	static constexpr int LANES = 64;
+	
+private:
+	std::vector<RpnInstruction> program;
+	std::vector<float> stack;
+	float loopResult[LANES];
+	int loopTerms[LANES]; // -1 where the count is undefined
+	int depth, results;
+	RpnInstruction::Status status;
+	
+	void EvaluateBlock(const RpnEnvironment &env, const float *const *lanes, int start, int n, const float *const *plotLanes);
+	
+public:
+	RpnBatch();
+	
+	// A program may leave more than one value, e.g. the x and y of a parametric curve
+	RpnInstruction::Status Compile(const std::vector<RpnInstruction> &instructions, int results = 1);
+	RpnInstruction::Status GetStatus() const;
+	
+	// Writes count results to out. Slot s reads lanes[s][i] for lane i if lanes is non-null
+	// and lanes[s] is non-null, and env[s] otherwise. Plot references read plotLanes the same
+	// way, falling back to env.plotValues.
+	void Evaluate(const RpnEnvironment &env, const float *const *lanes, int count, float *out, const float *const *plotLanes = nullptr);
+	// Same, for programs with several results; result r goes to outs[r]
+	void Evaluate(const RpnEnvironment &env, const float *const *lanes, int count, float *const *outs, const float *const *plotLanes = nullptr);
+	
+	// Iterates a map: each iteration evaluates the program and feeds the result back into
+	// state, which slot reads. Iterate k of lane i also goes to history[k * count + i] if
+	// history is non-null.
+	void Iterate(const RpnEnvironment &env, const float *const *lanes, int count, int slot, float *state, int iterations, float *history = nullptr);
+};
@@ -0,0 +1,417 @@
+#include "RpnComplex.h"
+#include <algorithm>
+#include <cmath>
+
+typedef RpnInstruction::func_t func_t;
+
+static constexpr float halfPi = 1.57079633f;
+static constexpr float invLn10 = 0.434294482f;
+
+// The kernels work in place on the n lanes of one or two stack entries, x = xr + xi i and
+// y = yr + yi i, and leave the result in x
+
+static void Multiply(float *xr, float *xi, const float *yr, const float *yi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float r = xr[i] * yr[i] - xi[i] * yi[i];
+		xi[i] = xr[i] * yi[i] + xi[i] * yr[i];
+		xr[i] = r;
+	}
+}
+
+static void Divide(float *xr, float *xi, const float *yr, const float *yi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float d = yr[i] * yr[i] + yi[i] * yi[i];
+		float r = (xr[i] * yr[i] + xi[i] * yi[i]) / d;
+		float m = (xi[i] * yr[i] - xr[i] * yi[i]) / d;
+		xr[i] = (d == 0) ? NAN : r;
+		xi[i] = (d == 0) ? NAN : m;
+	}
+}
+
+static void Exp(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float e = std::exp(xr[i]);
+		xr[i] = e * std::cos(xi[i]);
+		xi[i] = e * std::sin(xi[i]);
+	}
+}
+
+// Principal value, with the imaginary part in (-pi, pi]; undefined at 0. Adding 0 turns a -0
+// imaginary part (from negating a real) into +0, so negative reals get pi and not -pi.
+static void Log(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float modulus = std::hypot(xr[i], xi[i]);
+		float arg = std::atan2(xi[i] + 0.0f, xr[i]);
+		xr[i] = (modulus == 0) ? NAN : std::log(modulus);
+		xi[i] = (modulus == 0) ? NAN : arg;
+	}
+}
+
+// Principal value, with a real part of at least 0, and i (not -i) times the root of minus a
+// negative real, as in Log
+static void Sqrt(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float modulus = std::hypot(xr[i], xi[i]);
+		float r = std::sqrt((modulus + xr[i]) / 2);
+		float m = std::sqrt(std::max(0.0f, (modulus - xr[i]) / 2));
+		xr[i] = r;
+		xi[i] = std::copysign(m, xi[i] + 0.0f);
+	}
+}
+
+// sin(a + bi) = sin a cosh b + i cos a sinh b
+static void Sine(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float r = std::sin(xr[i]) * std::cosh(xi[i]);
+		xi[i] = std::cos(xr[i]) * std::sinh(xi[i]);
+		xr[i] = r;
+	}
+}
+
+// cos(a + bi) = cos a cosh b - i sin a sinh b
+static void Cosine(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float r = std::cos(xr[i]) * std::cosh(xi[i]);
+		xi[i] = -std::sin(xr[i]) * std::sinh(xi[i]);
+		xr[i] = r;
+	}
+}
+
+static void Tangent(float *xr, float *xi, int n)
+{
+	float cr[RpnComplex::LANES], ci[RpnComplex::LANES];
+	std::copy(xr, xr + n, cr);
+	std::copy(xi, xi + n, ci);
+	Sine(xr, xi, n);
+	Cosine(cr, ci, n);
+	Divide(xr, xi, cr, ci, n);
+}
+
+// asin z = -i log(iz + sqrt(1 - z^2))
+static void Arcsine(float *xr, float *xi, int n)
+{
+	float wr[RpnComplex::LANES], wi[RpnComplex::LANES];
+	for (int i=0; i<n; i++) {
+		wr[i] = 1 - (xr[i] * xr[i] - xi[i] * xi[i]);
+		wi[i] = -2 * xr[i] * xi[i];
+	}
+	Sqrt(wr, wi, n);
+	for (int i=0; i<n; i++) {
+		wr[i] -= xi[i];
+		wi[i] += xr[i];
+	}
+	Log(wr, wi, n);
+	for (int i=0; i<n; i++) {
+		xr[i] = wi[i];
+		xi[i] = -wr[i];
+	}
+}
+
+// atan z = i/2 (log(1 - iz) - log(1 + iz)), with the two logs of a + bi folded into one atan2
+// and one log1p:
+//     re = atan2(2a, 1 - a^2 - b^2) / 2
+//     im = log(|1 + b + ai|^2 / |1 - b - ai|^2) / 4 = log1p(4b / (a^2 + (1 - b)^2)) / 4
+// Undefined at +-i, like the logs. A -0 real part gives +pi/2 on the cut, as in Log.
+static void Arctangent(float *xr, float *xi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float a = xr[i], b = xi[i];
+		float below = a * a + (1 - b) * (1 - b);
+		float above = a * a + (1 + b) * (1 + b);
+		float r = std::atan2(2 * a + 0.0f, 1 - a * a - b * b) / 2;
+		float m = std::log1p(4 * b / below) / 4;
+		xr[i] = (below == 0 || above == 0) ? NAN : r;
+		xi[i] = (below == 0 || above == 0) ? NAN : m;
+	}
+}
+
+// x^y, by repeated multiplication for small whole powers (so (-2)^2 is exactly 4), and as
+// exp(y log x) otherwise
+static void Power(float *xr, float *xi, const float *yr, const float *yi, int n)
+{
+	for (int i=0; i<n; i++) {
+		float ar = xr[i], ai = xi[i], r, m;
+		if (ar != ar || ai != ai || yr[i] != yr[i] || yi[i] != yi[i]) {
+			r = m = NAN;
+		} else if (yi[i] == 0 && yr[i] == std::floor(yr[i]) && std::abs(yr[i]) <= 64) {
+			r = 1.0f;
+			m = 0.0f;
+			for (int e=(int)std::abs(yr[i]); e>0; e>>=1) {
+				if (e & 1) {
+					float t = r * ar - m * ai;
+					m = r * ai + m * ar;
+					r = t;
+				}
+				float t = ar * ar - ai * ai;
+				ai = 2 * ar * ai;
+				ar = t;
+			}
+			if (yr[i] < 0) {
+				float d = r * r + m * m;
+				r = (d == 0) ? NAN : r / d;
+				m = (d == 0) ? NAN : -m / d;
+			}
+		} else if (ar == 0 && ai == 0) {
+			r = m = (yr[i] > 0) ? 0.0f : NAN;
+		} else {
+			float lr = std::log(std::hypot(ar, ai)), li = std::atan2(ai + 0.0f, ar); // as in Log
+			float e = std::exp(yr[i] * lr - yi[i] * li), angle = yr[i] * li + yi[i] * lr;
+			r = e * std::cos(angle);
+			m = e * std::sin(angle);
+		}
+		xr[i] = r;
+		xi[i] = m;
+	}
+}
+
+// Functions RpnComplex doesn't know are only defined for real values in their domain
+static void Function(func_t f, int domain, float *xr, float *xi, int n)
+{
+	if (f == static_cast<func_t>(std::sqrt)) {
+		Sqrt(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::exp)) {
+		Exp(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::log) || f == static_cast<func_t>(std::log10)) {
+		Log(xr, xi, n);
+		if (f == static_cast<func_t>(std::log10)) {
+			for (int i=0; i<n; i++) {
+				xr[i] *= invLn10;
+				xi[i] *= invLn10;
+			}
+		}
+	} else if (f == static_cast<func_t>(std::sin)) {
+		Sine(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::cos)) {
+		Cosine(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::tan)) {
+		Tangent(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::asin) || f == static_cast<func_t>(std::acos)) {
+		Arcsine(xr, xi, n);
+		if (f == static_cast<func_t>(std::acos)) {
+			// acos z = pi/2 - asin z
+			for (int i=0; i<n; i++) {
+				xr[i] = halfPi - xr[i];
+				xi[i] = -xi[i];
+			}
+		}
+	} else if (f == static_cast<func_t>(std::atan)) {
+		Arctangent(xr, xi, n);
+	} else if (f == static_cast<func_t>(std::abs)) {
+		for (int i=0; i<n; i++) {
+			xr[i] = std::hypot(xr[i], xi[i]);
+			xi[i] = (xi[i] != xi[i]) ? NAN : 0.0f;
+		}
+	} else {
+		for (int i=0; i<n; i++) {
+			bool inDomain = (xi[i] == 0) && ((xr[i] > 0) ? (domain & RpnInstruction::D_POSITIVE) :
+				(xr[i] < 0) ? (domain & RpnInstruction::D_NEGATIVE) : (xr[i] == 0) && (domain & RpnInstruction::D_ZERO));
+			xr[i] = inDomain ? f(xr[i]) : NAN;
+			xi[i] = inDomain ? 0.0f : NAN;
+		}
+	}
+}
+
+RpnComplex::RpnComplex()
+{
+	depth = 0;
+	status = RpnInstruction::S_UNDERFLOW;
+}
+
+RpnInstruction::Status RpnComplex::Compile(const std::vector<RpnInstruction> &instructions)
+{
+	program = instructions;
+	status = CheckProgram(program, 1, depth);
+	if (status == RpnInstruction::S_OK) {
+		re.resize(depth * LANES);
+		im.resize(depth * LANES);
+	}
+	return status;
+}
+
+RpnInstruction::Status RpnComplex::GetStatus() const
+{
+	return status;
+}
+
+void RpnComplex::Evaluate(const RpnEnvironment &env, const float *const *laneRe, const float *const *laneIm, int count, float *outRe, float *outIm)
+{
+	if (status != RpnInstruction::S_OK) {
+		std::fill(outRe, outRe + count, NAN);
+		std::fill(outIm, outIm + count, NAN);
+		return;
+	}
+	
+	for (int start=0; start<count; start+=LANES) {
+		int n = std::min(count - start, (int)LANES);
+		EvaluateBlock(env, laneRe, laneIm, start, n);
+		
+		// Some kernels can leave one part defined (e.g. |inf + NaN i| is inf)
+		for (int i=0; i<n; i++) {
+			bool undefined = (re[i] != re[i]) || (im[i] != im[i]);
+			outRe[start + i] = undefined ? NAN : re[i];
+			outIm[start + i] = undefined ? NAN : im[i];
+		}
+	}
+}
+
+// Same layout as RpnBatch::EvaluateBlock, with the real and imaginary parts of entry k at
+// re[k * LANES] and im[k * LANES]
+void RpnComplex::EvaluateBlock(const RpnEnvironment &env, const float *const *laneRe, const float *const *laneIm, int start, int n)
+{
+	int sp = 0;
+	std::size_t loopBegin = 0;
+	int k = -1, kEnd = 0; // k is -1 outside a loop
+	
+	for (std::size_t pc=0; pc<program.size(); pc++) {
+		const RpnInstruction &inst = program[pc];
+		float *ar = &re[0] + (sp - 2) * LANES, *ai = &im[0] + (sp - 2) * LANES;
+		float *br = &re[0] + (sp - 1) * LANES, *bi = &im[0] + (sp - 1) * LANES;
+		float *dr = &re[0] + sp * LANES, *di = &im[0] + sp * LANES;
+		
+		switch (inst.op) {
+			case RpnInstruction::OP_PUSH:
+				std::fill(dr, dr + n, inst.value);
+				std::fill(di, di + n, 0.0f);
+				++sp;
+				break;
+			case RpnInstruction::OP_PUSHVAR:
+				if (inst.slot == RpnEnvironment::VAR_K && k >= 0) {
+					std::fill(dr, dr + n, (float)k);
+					std::fill(di, di + n, 0.0f);
+				} else if (laneRe != nullptr && laneRe[inst.slot] != nullptr) {
+					std::copy(laneRe[inst.slot] + start, laneRe[inst.slot] + start + n, dr);
+					if (laneIm != nullptr && laneIm[inst.slot] != nullptr) {
+						std::copy(laneIm[inst.slot] + start, laneIm[inst.slot] + start + n, di);
+					} else {
+						std::fill(di, di + n, 0.0f);
+					}
+				} else {
+					std::fill(dr, dr + n, env.values[inst.slot]);
+					std::fill(di, di + n, 0.0f);
+				}
+				++sp;
+				break;
+			case RpnInstruction::OP_PUSHPLOT:
+				std::fill(dr, dr + n, NAN);
+				std::fill(di, di + n, NAN);
+				++sp;
+				break;
+			case RpnInstruction::OP_ADD:
+				for (int i=0; i<n; i++) ar[i] += br[i];
+				for (int i=0; i<n; i++) ai[i] += bi[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_SUBTRACT:
+				for (int i=0; i<n; i++) ar[i] -= br[i];
+				for (int i=0; i<n; i++) ai[i] -= bi[i];
+				--sp;
+				break;
+			case RpnInstruction::OP_MULTIPLY:
+				Multiply(ar, ai, br, bi, n);
+				--sp;
+				break;
+			case RpnInstruction::OP_DIVIDE:
+				Divide(ar, ai, br, bi, n);
+				--sp;
+				break;
+			case RpnInstruction::OP_POWER:
+				Power(ar, ai, br, bi, n);
+				--sp;
+				break;
+			case RpnInstruction::OP_MODULO:
+			case RpnInstruction::OP_LESS:
+			case RpnInstruction::OP_GREATER:
+			case RpnInstruction::OP_MIN:
+			case RpnInstruction::OP_MAX:
+				// Only defined for real operands
+				for (int i=0; i<n; i++) {
+					float x = ar[i], y = br[i], r;
+					switch (inst.op) {
+						case RpnInstruction::OP_MODULO: r = (y == 0) ? NAN : std::fmod(x, y); break;
+						case RpnInstruction::OP_LESS: r = (x < y) ? 1.0f : 0.0f; break;
+						case RpnInstruction::OP_GREATER: r = (x > y) ? 1.0f : 0.0f; break;
+						case RpnInstruction::OP_MIN: r = std::min(x, y); break;
+						default: r = std::max(x, y); break;
+					}
+					bool real = (ai[i] == 0 && bi[i] == 0 && x == x && y == y);
+					ar[i] = real ? r : NAN;
+					ai[i] = real ? 0.0f : NAN;
+				}
+				--sp;
+				break;
+			case RpnInstruction::OP_SELECT: {
+				float *cr = &re[0] + (sp - 3) * LANES, *ci = &im[0] + (sp - 3) * LANES;
+				for (int i=0; i<n; i++) {
+					bool real = (ci[i] == 0 && cr[i] == cr[i]), pick = (cr[i] != 0);
+					cr[i] = !real ? NAN : pick ? ar[i] : br[i];
+					ci[i] = !real ? NAN : pick ? ai[i] : bi[i];
+				}
+				sp -= 2;
+				break;
+			}
+			case RpnInstruction::OP_NEGATE:
+				for (int i=0; i<n; i++) br[i] = -br[i];
+				for (int i=0; i<n; i++) bi[i] = -bi[i];
+				break;
+			case RpnInstruction::OP_FUNCTION:
+				Function(inst.func, inst.domain, br, bi, n);
+				break;
+			case RpnInstruction::OP_DUP:
+				std::copy(br, br + n, dr);
+				std::copy(bi, bi + n, di);
+				++sp;
+				break;
+			case RpnInstruction::OP_LOOP:
+				// The count has to be real, like the other counts
+				kEnd = 0;
+				for (int i=0; i<n; i++) {
+					loopTerms[i] = (bi[i] == 0 && br[i] >= 0 && br[i] <= RpnInstruction::MAX_TERMS) ? (int)br[i] : -1;
+					kEnd = std::max(kEnd, loopTerms[i]);
+				}
+				--sp;
+				loopBegin = pc;
+				k = 0;
+				break;
+			case RpnInstruction::OP_SUM:
+			case RpnInstruction::OP_PRODUCT:
+				if (k == 0) {
+					float none = (inst.op == RpnInstruction::OP_SUM) ? 0.0f : 1.0f;
+					for (int i=0; i<n; i++) {
+						loopRe[i] = (loopTerms[i] < 0) ? NAN : (loopTerms[i] > 0) ? br[i] : none;
+						loopIm[i] = (loopTerms[i] < 0) ? NAN : (loopTerms[i] > 0) ? bi[i] : 0.0f;
+					}
+				} else {
+					// Terms past a lane's count are replaced with 0 or 1, which change nothing
+					for (int i=0; i<n; i++) {
+						bool in = (k < loopTerms[i]);
+						br[i] = in ? br[i] : (inst.op == RpnInstruction::OP_SUM) ? 0.0f : 1.0f;
+						bi[i] = in ? bi[i] : 0.0f;
+					}
+					if (inst.op == RpnInstruction::OP_SUM) {
+						for (int i=0; i<n; i++) loopRe[i] += br[i];
+						for (int i=0; i<n; i++) loopIm[i] += bi[i];
+					} else {
+						Multiply(loopRe, loopIm, br, bi, n);
+					}
+				}
+				if (++k < kEnd) {
+					--sp;
+					pc = loopBegin; // back to the start of the body
+				} else {
+					std::copy(loopRe, loopRe + n, br);
+					std::copy(loopIm, loopIm + n, bi);
+					k = -1;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "RpnEnvironment.h"
+#include "RpnInstruction.h"
+
+// Evaluates an equation over complex numbers, for many values at once like RpnBatch. Square
+// roots, logarithms and inverse sines of values outside their real domain give the principal
+// complex value instead of being undefined. Each stack entry keeps the real and imaginary parts
+// of all the lanes in two separate arrays, so every operation is a plain loop over floats.
+// Comparisons, min, max and mod need real operands, and plot references are undefined.
+class RpnComplex
+{
+public:
+	static constexpr int LANES = 64;
+	
+private:
+	std::vector<RpnInstruction> program;
+	std::vector<float> re, im; // stack entry k of lane i is at k * LANES + i
+	float loopRe[LANES], loopIm[LANES];
+	int loopTerms[LANES];
+	int depth;
+	RpnInstruction::Status status;
+	
+	void EvaluateBlock(const RpnEnvironment &env, const float *const *laneRe, const float *const *laneIm, int start, int n);
+	
+public:
+	RpnComplex();
+	
+	RpnInstruction::Status Compile(const std::vector<RpnInstruction> &instructions);
+	RpnInstruction::Status GetStatus() const;
+	
+	// Writes count results to outRe and outIm. Slot s of lane i is laneRe[s][i] plus laneIm[s][i]
+	// times i where laneRe[s] is non-null (a null laneIm[s] is 0), and env[s] otherwise. A lane
+	// whose value is undefined comes out as NaN in both parts.
+	void Evaluate(const RpnEnvironment &env, const float *const *laneRe, const float *const *laneIm, int count, float *outRe, float *outIm);
+};
@@ -0,0 +1,29 @@
+#include "RpnEnvironment.h"
+
+RpnEnvironment::RpnEnvironment()
+{
+	for (int i=0; i<SLOT_COUNT; i++) {
+		values[i] = 0.0f;
+	}
+	plotValues = nullptr;
+	plotCount = 0;
+}
+
+float &RpnEnvironment::operator[](int slot)
+{
+	return values[slot];
+}
+
+float RpnEnvironment::operator[](int slot) const
+{
+	return values[slot];
+}
+
+const char *RpnEnvironment::SlotName(int slot)
+{
+	static const char *const names[] = { "x", "a", "b", "c", "d", "t", "y", "k" };
+	if (slot < 0 || slot >= (int)(sizeof(names) / sizeof(names[0]))) {
+		return "?";
+	}
+	return names[slot];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Values of the variables an equation can read, kept in one contiguous block. OP_PUSHVAR
+// instructions refer to a slot by index, so the same equation can be evaluated against any
+// number of environments, e.g. one per thread or one per value of a parameter sweep.
+class RpnEnvironment
+{
+public:
+	enum Slot {
+		VAR_X,
+		VAR_A,
+		VAR_B,
+		VAR_C,
+		VAR_D,
+		VAR_T, // parameter of parametric and polar plots
+		VAR_Y, // second coordinate of implicit plots
+		VAR_K, // index of a sum or product loop
+		TEMP_FIRST = 8, // slots from here on hold results of subexpressions moved out by HoistColumnWork
+		SLOT_COUNT = 16
+	};
+	
+	float values[SLOT_COUNT];
+	
+	// Values of the plots at the current x, read by OP_PUSHPLOT; null if there are none
+	const float *plotValues;
+	int plotCount;
+	
+	RpnEnvironment();
+	
+	float &operator[](int slot);
+	float operator[](int slot) const;
+	
+	static const char *SlotName(int slot);
+};
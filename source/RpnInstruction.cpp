@@ -1,4 +1,6 @@
 #include "RpnInstruction.h"
+#include "NumberFormat.h"
+#include <algorithm>
 #include <cmath>
 
 RpnInstruction::RpnInstruction()
@@ -17,11 +19,18 @@ RpnInstruction::RpnInstruction(float value)
 	this->value = value;
 }
 
-RpnInstruction::RpnInstruction(const float *var, const char *name)
+RpnInstruction::RpnInstruction(RpnEnvironment::Slot slot)
 {
 	op = OP_PUSHVAR;
-	this->var = var;
-	this->name = name;
+	this->slot = slot;
+	this->name = RpnEnvironment::SlotName(slot);
+}
+
+// OP_PUSHPLOT, the value of another plot at the current x
+RpnInstruction::RpnInstruction(Opcode opcode, int plot)
+{
+	op = opcode;
+	this->plot = plot;
 }
 
 RpnInstruction::RpnInstruction(func_t func, const char *name, int domain)
@@ -37,6 +46,60 @@ RpnInstruction::Opcode RpnInstruction::GetOpcode() const
 	return op;
 }
 
+// Number of values an instruction takes off the stack and puts back; false for unknown opcodes
+bool RpnInstruction::GetStackEffect(Opcode opcode, int &popped, int &pushed)
+{
+	pushed = 1;
+	switch (opcode) {
+		case OP_PUSH:
+		case OP_PUSHVAR:
+		case OP_PUSHPLOT:
+			popped = 0;
+			return true;
+		case OP_ADD:
+		case OP_SUBTRACT:
+		case OP_MULTIPLY:
+		case OP_DIVIDE:
+		case OP_MODULO:
+		case OP_POWER:
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_MIN:
+		case OP_MAX:
+			popped = 2;
+			return true;
+		case OP_SELECT:
+			popped = 3;
+			return true;
+		case OP_NEGATE:
+		case OP_FUNCTION:
+		case OP_SUM:
+		case OP_PRODUCT:
+			popped = 1;
+			return true;
+		case OP_LOOP:
+			popped = 1;
+			pushed = 0;
+			return true;
+		case OP_DUP:
+			popped = 1;
+			pushed = 2;
+			return true;
+		default:
+			return false;
+	}
+}
+
+int RpnInstruction::GetSlot() const
+{
+	return (op == OP_PUSHVAR) ? slot : -1;
+}
+
+int RpnInstruction::GetPlot() const
+{
+	return (op == OP_PUSHPLOT) ? plot : -1;
+}
+
 bool RpnInstruction::IsInDomain(float value) const
 {
 	if (value > 0)
@@ -48,15 +111,22 @@ bool RpnInstruction::IsInDomain(float value) const
 	return false; //Shouldn't happen in practice, but I don't think it's logically impossible. NaN maybe?
 }
 
-RpnInstruction::Status RpnInstruction::Execute(std::vector<float> &stack) const
+RpnInstruction::Status RpnInstruction::Execute(std::vector<float> &stack, const RpnEnvironment &env) const
 {
 	switch (op) {
 		case OP_PUSH:
 			stack.push_back(value);
 			return S_OK;
 		case OP_PUSHVAR:
-			stack.push_back(*var);
+			stack.push_back(env.values[slot]);
 			return S_OK;
+		case OP_PUSHPLOT:
+			if (env.plotValues == nullptr || plot < 0 || plot >= env.plotCount || env.plotValues[plot] != env.plotValues[plot]) {
+				return S_UNDEFINED;
+			} else {
+				stack.push_back(env.plotValues[plot]);
+				return S_OK;
+			}
 		case OP_ADD:
 			if (stack.size() < 2) {
 				return S_UNDERFLOW;
@@ -128,8 +198,48 @@ RpnInstruction::Status RpnInstruction::Execute(std::vector<float> &stack) const
 				stack.pop_back();
 				float x = stack.back();
 				stack.pop_back();
-				stack.push_back(std::pow(x, y));
-				return S_OK;
+				if (x != x || y != y) {
+					return S_UNDEFINED; // pow(NaN, 0) is 1
+				} else {
+					stack.push_back(std::pow(x, y));
+					return S_OK;
+				}
+			}
+		case OP_LESS:
+		case OP_GREATER:
+		case OP_MIN:
+		case OP_MAX:
+			if (stack.size() < 2) {
+				return S_UNDERFLOW;
+			} else {
+				float y = stack.back();
+				stack.pop_back();
+				float x = stack.back();
+				stack.pop_back();
+				if (x != x || y != y) {
+					return S_UNDEFINED;
+				} else {
+					stack.push_back((op == OP_LESS) ? (x < y) : (op == OP_GREATER) ? (x > y) : (op == OP_MIN) ? std::min(x, y) : std::max(x, y));
+					return S_OK;
+				}
+			}
+		case OP_SELECT:
+			if (stack.size() < 3) {
+				return S_UNDERFLOW;
+			} else {
+				float b = stack.back();
+				stack.pop_back();
+				float a = stack.back();
+				stack.pop_back();
+				float cond = stack.back();
+				stack.pop_back();
+				if (cond != cond) {
+					return S_UNDEFINED;
+				} else {
+					// The other value may be undefined; only the one chosen matters
+					stack.push_back((cond != 0) ? a : b);
+					return S_OK;
+				}
 			}
 		case OP_NEGATE:
 			if (stack.size() == 0) {
@@ -163,52 +273,256 @@ RpnInstruction::Status RpnInstruction::Execute(std::vector<float> &stack) const
 	}
 }
 
+// Copies text into out, truncated to fit, and returns its length
+static int CopyText(char *out, int size, const char *text)
+{
+	int length = 0;
+	while (text[length] != '\0' && length + 1 < size) {
+		out[length] = text[length];
+		++length;
+	}
+	if (size > 0) {
+		out[length] = '\0';
+	}
+	return length;
+}
+
+int RpnInstruction::Format(char *out, int size) const
+{
+	switch (op) {
+		case OP_PUSH: return FormatShortest(out, size, value);
+		case OP_ADD: return CopyText(out, size, "+");
+		case OP_SUBTRACT: return CopyText(out, size, "-");
+		case OP_MULTIPLY: return CopyText(out, size, "\xD7");
+		case OP_DIVIDE: return CopyText(out, size, "\xF7");
+		case OP_MODULO: return CopyText(out, size, "mod");
+		case OP_POWER: return CopyText(out, size, "^");
+		case OP_NEGATE: return CopyText(out, size, "\xB1");
+		case OP_PUSHVAR:
+		case OP_FUNCTION: return CopyText(out, size, name);
+		case OP_DUP: return CopyText(out, size, "dup");
+		case OP_PUSHPLOT: {
+			if (plot < 0) {
+				return CopyText(out, size, "y?");
+			}
+			int length = CopyText(out, size, "y");
+			return length + FormatFixed(out + length, size - length, (float)(plot + 1), 0);
+		}
+		case OP_LOOP: return CopyText(out, size, "[");
+		case OP_SUM: return CopyText(out, size, "]sum");
+		case OP_PRODUCT: return CopyText(out, size, "]prod");
+		case OP_LESS: return CopyText(out, size, "<");
+		case OP_GREATER: return CopyText(out, size, ">");
+		case OP_MIN: return CopyText(out, size, "min");
+		case OP_MAX: return CopyText(out, size, "max");
+		case OP_SELECT: return CopyText(out, size, "?");
+		default: return CopyText(out, size, "???");
+	}
+}
+
 std::ostream &operator<<(std::ostream &os, const RpnInstruction &inst)
 {
-	switch (inst.op) {
-		case RpnInstruction::OP_PUSH:
-			os << inst.value;
-			break;
-		case RpnInstruction::OP_ADD:
-			os << '+';
-			break;
-		case RpnInstruction::OP_SUBTRACT:
-			os << '-';
-			break;
-		case RpnInstruction::OP_MULTIPLY:
-			os << '\xD7';
-			break;
-		case RpnInstruction::OP_DIVIDE:
-			os << '\xF7';
-			break;
-		case RpnInstruction::OP_MODULO:
-			os << "mod";
-			break;
-		case RpnInstruction::OP_POWER:
-			os << '^';
-			break;
-		case RpnInstruction::OP_NEGATE:
-			os << '\xB1';
-			break;
-		case RpnInstruction::OP_PUSHVAR:
-		case RpnInstruction::OP_FUNCTION:
-			os << inst.name;
-			break;
-		case RpnInstruction::OP_DUP:
-			os << "dup";
-			break;
-		default:
-			os << "???";
+	char text[32];
+	inst.Format(text, sizeof(text));
+	return os << text;
+}
+
+RpnInstruction::Status FindLoopEnd(const std::vector<RpnInstruction> &instructions, std::size_t begin, std::size_t &end)
+{
+	int size = 0; // values the body has pushed so far
+	for (end=begin+1; end<instructions.size(); end++) {
+		RpnInstruction::Opcode op = instructions[end].GetOpcode();
+		int popped, pushed;
+		if (op == RpnInstruction::OP_SUM || op == RpnInstruction::OP_PRODUCT) {
+			return (size < 1) ? RpnInstruction::S_UNDERFLOW : (size > 1) ? RpnInstruction::S_OVERFLOW : RpnInstruction::S_OK;
+		} else if (op == RpnInstruction::OP_LOOP || !RpnInstruction::GetStackEffect(op, popped, pushed)) {
+			return RpnInstruction::S_UNDEFINED;
+		} else if (size < popped) {
+			return RpnInstruction::S_UNDERFLOW;
+		}
+		size += pushed - popped;
 	}
-	return os;
+	return RpnInstruction::S_UNDEFINED;
 }
 
-RpnInstruction::Status ExecuteRpn(const std::vector<RpnInstruction> instructions, float &resultOut)
+RpnInstruction::Status CheckProgram(const std::vector<RpnInstruction> &instructions, int results, int &depth)
+{
+	depth = 0;
+	int size = 0;
+	std::size_t loopEnd = 0;
+	for (std::size_t i=0; i<instructions.size(); i++) {
+		RpnInstruction::Opcode op = instructions[i].GetOpcode();
+		int popped, pushed;
+		if (!RpnInstruction::GetStackEffect(op, popped, pushed)) {
+			return RpnInstruction::S_UNDEFINED;
+		}
+		if (op == RpnInstruction::OP_LOOP) {
+			RpnInstruction::Status status = FindLoopEnd(instructions, i, loopEnd);
+			if (status != RpnInstruction::S_OK) {
+				return status;
+			}
+		} else if ((op == RpnInstruction::OP_SUM || op == RpnInstruction::OP_PRODUCT) && i != loopEnd) {
+			return RpnInstruction::S_UNDEFINED;
+		}
+		if (size < popped) {
+			return RpnInstruction::S_UNDERFLOW;
+		}
+		size += pushed - popped;
+		depth = std::max(depth, size);
+	}
+	
+	if (size < results) {
+		return RpnInstruction::S_UNDERFLOW;
+	} else if (size > results) {
+		return RpnInstruction::S_OVERFLOW;
+	}
+	return RpnInstruction::S_OK;
+}
+
+// Runs one instruction. An undefined value doesn't end the program; it leaves NaN in place of
+// the instruction's results, like an undefined lane of RpnBatch, so that OP_SELECT can still
+// pass over it. Loop ends outside of a loop are errors like unknown opcodes.
+static RpnInstruction::Status Step(const RpnInstruction &inst, std::vector<float> &stack, const RpnEnvironment &env)
+{
+	std::size_t size = stack.size();
+	RpnInstruction::Status status = inst.Execute(stack, env);
+	RpnInstruction::Opcode op = inst.GetOpcode();
+	int popped, pushed;
+	if (status == RpnInstruction::S_UNDEFINED && op != RpnInstruction::OP_SUM && op != RpnInstruction::OP_PRODUCT &&
+		RpnInstruction::GetStackEffect(op, popped, pushed) && (int)size >= popped) {
+		stack.resize(size - popped);
+		stack.resize(size - popped + pushed, NAN);
+		return RpnInstruction::S_OK;
+	}
+	return status;
+}
+
+// Runs the loop from begin to end, with the count on top of the stack, and leaves its result
+// there. FindLoopEnd has checked the body, so the terms skip the checks of Execute: they run over
+// a plain array sized for the body once, with k in a local instead of a copy of env, and an
+// undefined value just becomes NaN, as in Step.
+RpnInstruction::Status RpnInstruction::ExecuteLoop(const std::vector<RpnInstruction> &instructions, std::size_t begin, std::size_t end, const RpnEnvironment &env, std::vector<float> &stack)
+{
+	if (stack.size() == 0) {
+		return S_UNDERFLOW;
+	}
+	float count = stack.back();
+	stack.pop_back();
+	if (!(count >= 0 && count <= MAX_TERMS)) {
+		stack.push_back(NAN);
+		return S_OK;
+	}
+	
+	const RpnInstruction *body = &instructions[begin + 1];
+	int length = end - begin - 1;
+	int depth = 0, size = 0;
+	for (int i=0; i<length; i++) {
+		int popped, pushed;
+		GetStackEffect(body[i].op, popped, pushed);
+		size += pushed - popped;
+		depth = std::max(depth, size);
+	}
+	std::size_t base = stack.size();
+	stack.resize(base + depth);
+	float *values = &stack[base];
+	
+	bool product = (instructions[end].op == OP_PRODUCT);
+	float result = product ? 1.0f : 0.0f;
+	int terms = (int)count;
+	for (int k=0; k<terms; k++) {
+		float *top = values; // one past the top value
+		for (int i=0; i<length; i++) {
+			const RpnInstruction &inst = body[i];
+			switch (inst.op) {
+				case OP_PUSH:
+					*top++ = inst.value;
+					break;
+				case OP_PUSHVAR:
+					*top++ = (inst.slot == RpnEnvironment::VAR_K) ? (float)k : env.values[inst.slot];
+					break;
+				case OP_PUSHPLOT:
+					*top++ = (env.plotValues != nullptr && inst.plot >= 0 && inst.plot < env.plotCount) ? env.plotValues[inst.plot] : NAN;
+					break;
+				case OP_ADD:
+					--top;
+					top[-1] += top[0];
+					break;
+				case OP_SUBTRACT:
+					--top;
+					top[-1] -= top[0];
+					break;
+				case OP_MULTIPLY:
+					--top;
+					top[-1] *= top[0];
+					break;
+				case OP_DIVIDE:
+					--top;
+					top[-1] = (top[0] == 0) ? NAN : top[-1] / top[0];
+					break;
+				case OP_MODULO:
+					--top;
+					top[-1] = (top[0] == 0) ? NAN : std::fmod(top[-1], top[0]);
+					break;
+				case OP_POWER:
+					--top;
+					top[-1] = (top[-1] != top[-1] || top[0] != top[0]) ? NAN : std::pow(top[-1], top[0]);
+					break;
+				case OP_LESS:
+				case OP_GREATER:
+				case OP_MIN:
+				case OP_MAX: {
+					--top;
+					float x = top[-1], y = top[0];
+					if (x != x || y != y) {
+						top[-1] = NAN;
+					} else {
+						top[-1] = (inst.op == OP_LESS) ? (x < y) : (inst.op == OP_GREATER) ? (x > y) : (inst.op == OP_MIN) ? std::min(x, y) : std::max(x, y);
+					}
+					break;
+				}
+				case OP_SELECT:
+					top -= 2;
+					top[-1] = (top[-1] != top[-1]) ? NAN : (top[-1] != 0) ? top[0] : top[1];
+					break;
+				case OP_NEGATE:
+					top[-1] = -top[-1];
+					break;
+				case OP_FUNCTION:
+					top[-1] = inst.IsInDomain(top[-1]) ? inst.func(top[-1]) : NAN;
+					break;
+				case OP_DUP:
+					top[0] = top[-1];
+					++top;
+					break;
+				default:
+					stack.resize(base);
+					return S_UNDEFINED;
+			}
+		}
+		result = product ? result * values[0] : result + values[0];
+	}
+	
+	stack.resize(base);
+	stack.push_back(result);
+	return S_OK;
+}
+
+RpnInstruction::Status ExecuteRpn(const std::vector<RpnInstruction> &instructions, const RpnEnvironment &env, float &resultOut)
 {
 	std::vector<float> stack;
 	
-	for (auto i = instructions.begin(); i != instructions.end(); i++) {
-		RpnInstruction::Status status = i->Execute(stack);
+	for (std::size_t i=0; i<instructions.size(); i++) {
+		RpnInstruction::Status status;
+		if (instructions[i].GetOpcode() == RpnInstruction::OP_LOOP) {
+			std::size_t end;
+			status = FindLoopEnd(instructions, i, end);
+			if (status == RpnInstruction::S_OK) {
+				status = RpnInstruction::ExecuteLoop(instructions, i, end, env, stack);
+				i = end;
+			}
+		} else {
+			status = Step(instructions[i], stack, env);
+		}
 		if (status != RpnInstruction::S_OK) {
 			return status;
 		}
@@ -218,8 +532,222 @@ RpnInstruction::Status ExecuteRpn(const std::vector<RpnInstruction> instructions
 		return RpnInstruction::S_UNDERFLOW;
 	} else if (stack.size() > 1) {
 		return RpnInstruction::S_OVERFLOW;
+	} else if (stack.back() != stack.back()) {
+		return RpnInstruction::S_UNDEFINED;
 	} else {
 		resultOut = stack.back();
 		return RpnInstruction::S_OK;
 	}
+}
+
+// Stack entry seen by HoistInvariants: a constant that hasn't been written to the output yet,
+// or a value the output program computes at run time
+struct HoistEntry
+{
+	bool pending;
+	float value;
+};
+
+// Writes out the pending constants. They are always on top of the stack, since anything that
+// is computed at run time flushes them first.
+static void FlushPending(std::vector<HoistEntry> &stack, std::vector<RpnInstruction> &out)
+{
+	std::size_t first = stack.size();
+	while (first > 0 && stack[first - 1].pending) {
+		--first;
+	}
+	
+	for (std::size_t i=first; i<stack.size(); i++) {
+		out.push_back(RpnInstruction(stack[i].value));
+		stack[i].pending = false;
+	}
+}
+
+void HoistInvariants(const std::vector<RpnInstruction> &instructions, const RpnEnvironment &env, unsigned varyingSlots, std::vector<RpnInstruction> &out)
+{
+	std::vector<HoistEntry> stack;
+	std::vector<float> foldStack;
+	out.clear();
+	
+	for (auto i = instructions.begin(); i != instructions.end(); i++) {
+		int arity, results;
+		RpnInstruction::Opcode op = i->GetOpcode();
+		// Other plots are read at the current x, so they always vary, and so does the loop
+		// index. The loops themselves are kept, though their bodies are folded like the rest.
+		bool varying = (op == RpnInstruction::OP_PUSHPLOT) ||
+			(op == RpnInstruction::OP_LOOP) || (op == RpnInstruction::OP_SUM) || (op == RpnInstruction::OP_PRODUCT) ||
+			((op == RpnInstruction::OP_PUSHVAR) && ((varyingSlots & (1u << i->GetSlot())) || i->GetSlot() == RpnEnvironment::VAR_K));
+		
+		if (!RpnInstruction::GetStackEffect(i->GetOpcode(), arity, results) || (int)stack.size() < arity) {
+			// Keep the rest as it is, so the output fails the same way the original does
+			FlushPending(stack, out);
+			out.insert(out.end(), i, instructions.end());
+			return;
+		}
+		
+		bool constant = !varying;
+		for (int k=0; k<arity; k++) {
+			constant = constant && stack[stack.size() - 1 - k].pending;
+		}
+		
+		if (constant) {
+			foldStack.clear();
+			for (std::size_t k=stack.size()-arity; k<stack.size(); k++) {
+				foldStack.push_back(stack[k].value);
+			}
+			// If this fails (e.g. division by zero), it's left for run time to fail the same way
+			if (i->Execute(foldStack, env) == RpnInstruction::S_OK) {
+				stack.resize(stack.size() - arity);
+				for (float value : foldStack) {
+					stack.push_back(HoistEntry{true, value});
+				}
+				continue;
+			}
+		}
+		
+		FlushPending(stack, out);
+		out.push_back(*i);
+		stack.resize(stack.size() - arity);
+		for (int k=0; k<results; k++) {
+			stack.push_back(HoistEntry{false, 0.0f});
+		}
+	}
+	
+	FlushPending(stack, out);
+}
+
+// Stack entry seen by HoistColumnWork: a value only computed from column slots, with the code
+// that computes it, or a value the output program computes
+struct ColumnEntry
+{
+	bool pending;
+	std::vector<RpnInstruction> code;
+};
+
+static void FlushColumnWork(std::vector<ColumnEntry> &stack, int firstTemp, std::vector<RpnInstruction> &out, std::vector<std::vector<RpnInstruction>> &temps)
+{
+	std::size_t first = stack.size();
+	while (first > 0 && stack[first - 1].pending) {
+		--first;
+	}
+	
+	for (std::size_t i=first; i<stack.size(); i++) {
+		std::vector<RpnInstruction> &code = stack[i].code;
+		int slot = firstTemp + (int)temps.size();
+		
+		if (code.size() == 1 || slot >= RpnEnvironment::SLOT_COUNT) {
+			// Not worth a temp (a single push), or out of temps
+			out.insert(out.end(), code.begin(), code.end());
+		} else {
+			temps.push_back(code);
+			out.push_back(RpnInstruction((RpnEnvironment::Slot)slot));
+		}
+		
+		stack[i].pending = false;
+		code.clear();
+	}
+}
+
+void HoistColumnWork(const std::vector<RpnInstruction> &instructions, unsigned columnSlots, int firstTemp, std::vector<RpnInstruction> &out, std::vector<std::vector<RpnInstruction>> &temps)
+{
+	std::vector<ColumnEntry> stack;
+	out.clear();
+	temps.clear();
+	
+	for (auto i = instructions.begin(); i != instructions.end(); i++) {
+		RpnInstruction::Opcode op = i->GetOpcode();
+		int arity, results;
+		
+		if (!RpnInstruction::GetStackEffect(op, arity, results) || (int)stack.size() < arity) {
+			FlushColumnWork(stack, firstTemp, out, temps);
+			out.insert(out.end(), i, instructions.end());
+			return;
+		}
+		
+		bool column;
+		if (op == RpnInstruction::OP_PUSH || op == RpnInstruction::OP_PUSHPLOT) {
+			column = true;
+		} else if (op == RpnInstruction::OP_PUSHVAR) {
+			column = (columnSlots & (1u << i->GetSlot())) && i->GetSlot() != RpnEnvironment::VAR_K;
+		} else if (op == RpnInstruction::OP_LOOP || op == RpnInstruction::OP_SUM || op == RpnInstruction::OP_PRODUCT) {
+			// The loop stays in the output; the column work in its body can still be moved out
+			column = false;
+		} else {
+			column = true;
+			for (int k=0; k<arity; k++) {
+				column = column && stack[stack.size() - 1 - k].pending;
+			}
+		}
+		
+		if (column) {
+			std::vector<RpnInstruction> code;
+			for (std::size_t k=stack.size()-arity; k<stack.size(); k++) {
+				code.insert(code.end(), stack[k].code.begin(), stack[k].code.end());
+			}
+			// Both copies made by dup are just the operand
+			if (op != RpnInstruction::OP_DUP) {
+				code.push_back(*i);
+			}
+			
+			stack.resize(stack.size() - arity);
+			for (int k=0; k<results; k++) {
+				stack.push_back(ColumnEntry{true, code});
+			}
+		} else {
+			FlushColumnWork(stack, firstTemp, out, temps);
+			out.push_back(*i);
+			stack.resize(stack.size() - arity);
+			for (int k=0; k<results; k++) {
+				stack.push_back(ColumnEntry{false, std::vector<RpnInstruction>()});
+			}
+		}
+	}
+	
+	FlushColumnWork(stack, firstTemp, out, temps);
+}
+
+enum VisitState { V_NEW, V_VISITING, V_DONE };
+
+// Depth-first visit; a plot is added to order after everything it reads
+static ReferenceStatus VisitPlot(const std::vector<const std::vector<RpnInstruction>*> &plots, int index, std::vector<VisitState> &state, std::vector<int> &order, std::vector<ReferenceStatus> &status)
+{
+	if (state[index] == V_DONE) {
+		return status[index];
+	}
+	if (state[index] == V_VISITING) {
+		return R_CYCLE;
+	}
+	
+	state[index] = V_VISITING;
+	ReferenceStatus result = R_OK;
+	for (const RpnInstruction &inst : *plots[index]) {
+		int plot = inst.GetPlot();
+		if (inst.GetOpcode() == RpnInstruction::OP_PUSHPLOT && result == R_OK) {
+			if (plot < 0 || plot >= (int)plots.size()) {
+				result = R_DANGLING;
+			} else {
+				result = VisitPlot(plots, plot, state, order, status);
+			}
+		}
+	}
+	state[index] = V_DONE;
+	
+	status[index] = result;
+	if (result == R_OK) {
+		order.push_back(index);
+	}
+	return result;
+}
+
+bool OrderByReferences(const std::vector<const std::vector<RpnInstruction>*> &plots, std::vector<int> &order, std::vector<ReferenceStatus> &status)
+{
+	int count = plots.size();
+	std::vector<VisitState> state(count, V_NEW);
+	order.clear();
+	status.assign(count, R_OK);
+	
+	for (int i=0; i<count; i++) {
+		VisitPlot(plots, i, state, order, status);
+	}
+	return (int)order.size() == count;
 }
\ No newline at end of file
@@ -2,10 +2,14 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include "RpnEnvironment.h"
 
 class RpnInstruction
 {
 	friend std::ostream &operator<<(std::ostream &os, const RpnInstruction &inst);
+	friend class RpnBatch;
+	friend class RpnInterval;
+	friend class RpnComplex;
 	
 public:
 	enum Opcode {
@@ -20,7 +24,16 @@ public:
 		OP_POWER,
 		OP_NEGATE,
 		OP_FUNCTION,
-		OP_DUP
+		OP_DUP,
+		OP_PUSHPLOT,
+		OP_LOOP, // takes a count n; the instructions up to the next OP_SUM or OP_PRODUCT run n times
+		OP_SUM, // sum of the loop body's value for k = 0 to n - 1
+		OP_PRODUCT, // product of the same
+		OP_LESS, // 1 if true, 0 if not
+		OP_GREATER,
+		OP_MIN,
+		OP_MAX,
+		OP_SELECT // cond a b ?: a if cond isn't 0, b if it is
 	};
 	
 	enum Status {
@@ -39,13 +52,16 @@ public:
 	
 	typedef float (*func_t)(float);
 	
+	static constexpr int MAX_TERMS = 1000; // longest loop; a longer one is undefined
+	
 private:
 	Opcode op;
 	union {
 		float value;
 		struct {
 			union {
-				const float *var;
+				int slot;
+				int plot;
 				struct {
 					func_t func;
 					int domain;
@@ -56,18 +72,64 @@ private:
 	}; // Yes, I know that was complex. :)
 	
 	bool IsInDomain(float value) const;
+	static Status ExecuteLoop(const std::vector<RpnInstruction> &instructions, std::size_t begin, std::size_t end, const RpnEnvironment &env, std::vector<float> &stack);
+	
+	friend Status ExecuteRpn(const std::vector<RpnInstruction> &instructions, const RpnEnvironment &env, float &resultOut);
 	
 public:
 	RpnInstruction();
 	RpnInstruction(Opcode opcode);
 	RpnInstruction(float value);
-	RpnInstruction(const float *var, const char *name);
+	RpnInstruction(RpnEnvironment::Slot slot);
+	RpnInstruction(Opcode opcode, int plot);
 	RpnInstruction(func_t func, const char *name, int domain = D_ALL);
 	
 	Opcode GetOpcode() const;
-	Status Execute(std::vector<float> &stack) const;
+	static bool GetStackEffect(Opcode opcode, int &popped, int &pushed);
+	int GetSlot() const;
+	int GetPlot() const;
+	// Writes the token shown for this instruction, like FormatFixed: truncated to fit, no
+	// allocation, and returns the length
+	int Format(char *out, int size) const;
+	Status Execute(std::vector<float> &stack, const RpnEnvironment &env) const;
 };
 
 std::ostream &operator<<(std::ostream &os, const RpnInstruction &inst);
 
-RpnInstruction::Status ExecuteRpn(const std::vector<RpnInstruction> instructions, float &resultOut);
\ No newline at end of file
+RpnInstruction::Status ExecuteRpn(const std::vector<RpnInstruction> &instructions, const RpnEnvironment &env, float &resultOut);
+
+// Checks that a program leaves results values on the stack and never takes more than it has,
+// and finds the most values it holds at once. The values don't matter, so batch evaluators
+// only check once for all of them.
+RpnInstruction::Status CheckProgram(const std::vector<RpnInstruction> &instructions, int results, int &depth);
+
+// Finds the OP_SUM or OP_PRODUCT that ends the loop started by the OP_LOOP at begin. Loops can't
+// be nested, and a loop body can only use the values it pushes itself and must leave one.
+RpnInstruction::Status FindLoopEnd(const std::vector<RpnInstruction> &instructions, std::size_t begin, std::size_t &end);
+
+// Copies instructions to out with every subexpression that doesn't read one of the slots in
+// varyingSlots (a bit mask of 1 << slot) evaluated against env and replaced with a constant.
+// Evaluating out gives the same results as the original, as long as only the varying slots
+// of env change.
+void HoistInvariants(const std::vector<RpnInstruction> &instructions, const RpnEnvironment &env, unsigned varyingSlots, std::vector<RpnInstruction> &out);
+
+// Moves the subexpressions that only read the slots in columnSlots out of instructions into
+// separate programs, and replaces them with reads of the slots firstTemp, firstTemp + 1 and so
+// on. Storing the result of temps[k] in slot firstTemp + k and then evaluating out gives the same
+// result as instructions, so the temps can be computed once and shared by every value of the
+// other slots.
+void HoistColumnWork(const std::vector<RpnInstruction> &instructions, unsigned columnSlots, int firstTemp, std::vector<RpnInstruction> &out, std::vector<std::vector<RpnInstruction>> &temps);
+
+enum ReferenceStatus
+{
+	R_OK,
+	R_CYCLE, // the plot reads itself through other plots
+	R_DANGLING // the plot reads one that doesn't exist
+};
+
+// Puts the plots in an order where each one comes after the plots it reads with OP_PUSHPLOT, so
+// each plot's samples can be computed once and read by the plots after it. Plots that are part
+// of a reference cycle, or read a plot that doesn't exist, are left out of order with R_CYCLE or
+// R_DANGLING in status, as are the plots that read them (with the reason of the first one they
+// read); the others get R_OK. Returns false if any plot is broken.
+bool OrderByReferences(const std::vector<const std::vector<RpnInstruction>*> &plots, std::vector<int> &order, std::vector<ReferenceStatus> &status);
\ No newline at end of file
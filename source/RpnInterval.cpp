@@ -0,0 +1,315 @@
+#include "RpnInterval.h"
+#include <algorithm>
+#include <cmath>
+
+typedef RpnInterval::Range Range;
+typedef RpnInstruction::func_t func_t;
+
+static constexpr float pi = 3.14159265f;
+
+static const Range empty = { INFINITY, -INFINITY };
+static const Range whole = { -INFINITY, INFINITY };
+
+bool Range::IsEmpty() const
+{
+	return !(lo <= hi);
+}
+
+bool Range::Contains(float value) const
+{
+	return lo <= value && value <= hi;
+}
+
+// The range spanned by a few values; unbounded if any of them is NaN (e.g. from inf - inf)
+static Range Span(float a, float b)
+{
+	if (a != a || b != b) {
+		return whole;
+	}
+	return Range{ std::min(a, b), std::max(a, b) };
+}
+
+static Range Span(float a, float b, float c, float d)
+{
+	Range r = Span(a, b), s = Span(c, d);
+	return Range{ std::min(r.lo, s.lo), std::max(r.hi, s.hi) };
+}
+
+static Range Multiply(Range x, Range y)
+{
+	return Span(x.lo * y.lo, x.lo * y.hi, x.hi * y.lo, x.hi * y.hi);
+}
+
+// 1 / x; an exact zero is undefined, like OP_DIVIDE
+static Range Reciprocal(Range x)
+{
+	if (x.lo > 0 || x.hi < 0) {
+		return Span(1 / x.lo, 1 / x.hi);
+	} else if (x.lo == 0 && x.hi == 0) {
+		return empty;
+	} else if (x.lo == 0) {
+		return Range{ 1 / x.hi, INFINITY };
+	} else if (x.hi == 0) {
+		return Range{ -INFINITY, 1 / x.lo };
+	}
+	return whole;
+}
+
+// Whether offset + k * period lies in x for some whole k
+static bool HitsPeriodic(Range x, float offset, float period)
+{
+	float k = std::ceil((x.lo - offset) / period);
+	return offset + k * period <= x.hi;
+}
+
+static Range Sine(Range x)
+{
+	if (!(x.hi - x.lo < 2 * pi)) {
+		return Range{ -1.0f, 1.0f };
+	}
+	Range r = Span(std::sin(x.lo), std::sin(x.hi));
+	if (HitsPeriodic(x, pi / 2, 2 * pi)) {
+		r.hi = 1.0f;
+	}
+	if (HitsPeriodic(x, -pi / 2, 2 * pi)) {
+		r.lo = -1.0f;
+	}
+	return r;
+}
+
+Range RpnInterval::Function(const RpnInstruction &inst, Range x)
+{
+	// Values outside the domain are undefined, so they don't widen the result
+	if (!(inst.domain & RpnInstruction::D_NEGATIVE)) {
+		x.lo = std::max(x.lo, 0.0f);
+	}
+	if (!(inst.domain & RpnInstruction::D_POSITIVE)) {
+		x.hi = std::min(x.hi, 0.0f);
+	}
+	if (!(inst.domain & RpnInstruction::D_ZERO) && x.lo == 0 && x.hi == 0) {
+		return empty;
+	}
+	if (x.IsEmpty()) {
+		return empty;
+	}
+
+	func_t f = inst.func;
+	if (f == static_cast<func_t>(std::sin)) {
+		return Sine(x);
+	} else if (f == static_cast<func_t>(std::cos)) {
+		return Sine(Range{ x.lo + pi / 2, x.hi + pi / 2 });
+	} else if (f == static_cast<func_t>(std::tan)) {
+		if (!(x.hi - x.lo < pi) || HitsPeriodic(x, pi / 2, pi)) {
+			return whole;
+		}
+		return Span(std::tan(x.lo), std::tan(x.hi));
+	} else if (f == static_cast<func_t>(std::abs)) {
+		if (x.lo >= 0) {
+			return x;
+		} else if (x.hi <= 0) {
+			return Range{ -x.hi, -x.lo };
+		}
+		return Range{ 0.0f, std::max(-x.lo, x.hi) };
+	} else if (f == static_cast<func_t>(std::asin) || f == static_cast<func_t>(std::acos)) {
+		x.lo = std::max(x.lo, -1.0f);
+		x.hi = std::min(x.hi, 1.0f);
+		if (x.IsEmpty()) {
+			return empty;
+		}
+		return Span(f(x.lo), f(x.hi));
+	} else if (f == static_cast<func_t>(std::sqrt) || f == static_cast<func_t>(std::exp) ||
+		f == static_cast<func_t>(std::log) || f == static_cast<func_t>(std::log10) ||
+		f == static_cast<func_t>(std::atan)) {
+		// Monotonic over their domains, so the ends of the range map to the ends of the result
+		return Span(f(x.lo), f(x.hi));
+	}
+	return whole;
+}
+
+Range RpnInterval::Power(Range x, Range y)
+{
+	if (y.lo == y.hi && y.lo == std::floor(y.lo) && std::abs(y.lo) < 64) {
+		int n = std::abs((int)y.lo);
+		float e = n;
+		Range r;
+		if (n == 0) {
+			return Range{ 1.0f, 1.0f };
+		} else if (n % 2 == 1 || x.lo >= 0) {
+			r = Span(std::pow(x.lo, e), std::pow(x.hi, e));
+		} else if (x.hi <= 0) {
+			r = Span(std::pow(x.hi, e), std::pow(x.lo, e));
+		} else {
+			r = Range{ 0.0f, std::pow(std::max(-x.lo, x.hi), e) };
+		}
+		return (y.lo < 0) ? Reciprocal(r) : r;
+	}
+
+	if (x.lo > 0) {
+		// Monotonic in each argument for positive bases
+		return Span(std::pow(x.lo, y.lo), std::pow(x.lo, y.hi), std::pow(x.hi, y.lo), std::pow(x.hi, y.hi));
+	}
+	return whole;
+}
+
+// Sum or product of some number of terms in terms (whole numbers), each in body
+Range RpnInterval::Loop(RpnInstruction::Opcode op, Range terms, Range body)
+{
+	bool sum = (op == RpnInstruction::OP_SUM);
+	if (terms.IsEmpty()) {
+		return empty;
+	} else if (body.IsEmpty()) {
+		// Only a loop that doesn't run is defined
+		return (terms.lo == 0) ? Range{ sum ? 0.0f : 1.0f, sum ? 0.0f : 1.0f } : empty;
+	}
+
+	float m = terms.lo, n = terms.hi;
+	if (sum) {
+		// Between m and n times the smallest and largest term
+		return Span(m * body.lo, m * body.hi, n * body.lo, n * body.hi);
+	} else if (body.lo >= 0) {
+		return Span(std::pow(body.lo, m), std::pow(body.lo, n), std::pow(body.hi, m), std::pow(body.hi, n));
+	}
+	float most = std::max(std::pow(std::max(-body.lo, body.hi), m), std::pow(std::max(-body.lo, body.hi), n));
+	return Span(-most, most);
+}
+
+// Either value, depending on which ones cond can pick. Unlike the other operations, a value
+// that is undefined everywhere only makes the result undefined where it's picked.
+Range RpnInterval::Select(Range cond, Range a, Range b)
+{
+	if (cond.IsEmpty()) {
+		return empty;
+	}
+	Range r = empty;
+	if (cond.lo != 0 || cond.hi != 0) {
+		r = Range{ std::min(r.lo, a.lo), std::max(r.hi, a.hi) };
+	}
+	if (cond.Contains(0)) {
+		r = Range{ std::min(r.lo, b.lo), std::max(r.hi, b.hi) };
+	}
+	return r;
+}
+
+Range RpnInterval::Evaluate(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const Range *const *ranges)
+{
+	stack.clear();
+	Range terms = empty; // how many times the current loop body runs
+	bool inLoop = false;
+
+	for (const RpnInstruction &inst : program) {
+		if (inst.op == RpnInstruction::OP_LOOP) {
+			if (stack.empty()) {
+				return whole;
+			}
+			// Counts past the limit are undefined, so only the ones up to it can give a value
+			Range count = stack.back();
+			stack.pop_back();
+			terms = Range{ std::floor(std::max(count.lo, 0.0f)), std::floor(std::min(count.hi, (float)RpnInstruction::MAX_TERMS)) };
+			inLoop = true;
+			continue;
+		} else if (inst.op == RpnInstruction::OP_SUM || inst.op == RpnInstruction::OP_PRODUCT) {
+			if (stack.empty() || !inLoop) {
+				return whole;
+			}
+			stack.back() = Loop(inst.op, terms, stack.back());
+			inLoop = false;
+			continue;
+		} else if (inst.op == RpnInstruction::OP_SELECT) {
+			if (stack.size() < 3) {
+				return whole;
+			}
+			Range b = stack.back();
+			stack.pop_back();
+			Range a = stack.back();
+			stack.pop_back();
+			stack.back() = Select(stack.back(), a, b);
+			continue;
+		}
+
+		int popped, pushed;
+		if (!RpnInstruction::GetStackEffect(inst.op, popped, pushed) || (int)stack.size() < popped) {
+			return whole;
+		}
+
+		Range y = (popped >= 1) ? stack[stack.size() - 1] : whole;
+		Range x = (popped >= 2) ? stack[stack.size() - 2] : whole;
+		stack.resize(stack.size() - popped);
+
+		// An operand that is undefined everywhere makes the result undefined everywhere
+		if ((popped >= 1 && y.IsEmpty()) || (popped >= 2 && x.IsEmpty())) {
+			stack.resize(stack.size() + pushed, empty);
+			continue;
+		}
+
+		switch (inst.op) {
+			case RpnInstruction::OP_PUSH:
+				stack.push_back(Range{ inst.value, inst.value });
+				break;
+			case RpnInstruction::OP_PUSHVAR:
+				if (inst.slot == RpnEnvironment::VAR_K && inLoop) {
+					stack.push_back(terms.IsEmpty() ? empty : Range{ 0.0f, std::max(terms.hi - 1, 0.0f) });
+				} else if (ranges != nullptr && ranges[inst.slot] != nullptr) {
+					stack.push_back(*ranges[inst.slot]);
+				} else {
+					stack.push_back(Range{ env[inst.slot], env[inst.slot] });
+				}
+				break;
+			case RpnInstruction::OP_PUSHPLOT:
+				stack.push_back(whole);
+				break;
+			case RpnInstruction::OP_ADD:
+				stack.push_back(Span(x.lo + y.lo, x.hi + y.hi));
+				break;
+			case RpnInstruction::OP_SUBTRACT:
+				stack.push_back(Span(x.lo - y.hi, x.hi - y.lo));
+				break;
+			case RpnInstruction::OP_MULTIPLY:
+				stack.push_back(Multiply(x, y));
+				break;
+			case RpnInstruction::OP_DIVIDE: {
+				Range r = Reciprocal(y);
+				stack.push_back(r.IsEmpty() ? empty : Multiply(x, r));
+				break;
+			}
+			case RpnInstruction::OP_MODULO: {
+				// The remainder has the sign of x and is smaller than both |x| and |y|
+				float m = std::max(std::abs(y.lo), std::abs(y.hi));
+				if (m == 0) {
+					stack.push_back(empty);
+				} else {
+					stack.push_back(Range{ std::max(std::min(x.lo, 0.0f), -m), std::min(std::max(x.hi, 0.0f), m) });
+				}
+				break;
+			}
+			case RpnInstruction::OP_POWER:
+				stack.push_back(Power(x, y));
+				break;
+			case RpnInstruction::OP_LESS:
+				stack.push_back((x.hi < y.lo) ? Range{ 1.0f, 1.0f } : (x.lo >= y.hi) ? Range{ 0.0f, 0.0f } : Range{ 0.0f, 1.0f });
+				break;
+			case RpnInstruction::OP_GREATER:
+				stack.push_back((x.lo > y.hi) ? Range{ 1.0f, 1.0f } : (x.hi <= y.lo) ? Range{ 0.0f, 0.0f } : Range{ 0.0f, 1.0f });
+				break;
+			case RpnInstruction::OP_MIN:
+				stack.push_back(Range{ std::min(x.lo, y.lo), std::min(x.hi, y.hi) });
+				break;
+			case RpnInstruction::OP_MAX:
+				stack.push_back(Range{ std::max(x.lo, y.lo), std::max(x.hi, y.hi) });
+				break;
+			case RpnInstruction::OP_NEGATE:
+				stack.push_back(Range{ -y.hi, -y.lo });
+				break;
+			case RpnInstruction::OP_FUNCTION:
+				stack.push_back(Function(inst, y));
+				break;
+			case RpnInstruction::OP_DUP:
+				stack.push_back(y);
+				stack.push_back(y);
+				break;
+			default:
+				return whole;
+		}
+	}
+
+	return (stack.size() == 1) ? stack[0] : whole;
+}
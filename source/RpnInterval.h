@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "RpnEnvironment.h"
+#include "RpnInstruction.h"
+
+// Bounds the values an equation takes while its variables move over ranges, using interval
+// arithmetic. The bounds are conservative (up to float rounding): they may be wider than the
+// real range of values, but never narrower, so a range that doesn't contain zero proves the
+// equation has no root there.
+class RpnInterval
+{
+public:
+	struct Range
+	{
+		float lo, hi; // lo > hi if the equation is undefined over the whole range
+
+		bool IsEmpty() const;
+		bool Contains(float value) const;
+	};
+
+private:
+	std::vector<Range> stack;
+
+	static Range Function(const RpnInstruction &inst, Range x);
+	static Range Power(Range x, Range y);
+	static Range Loop(RpnInstruction::Opcode op, Range terms, Range body);
+	static Range Select(Range cond, Range a, Range b);
+
+public:
+	// Slot s ranges over ranges[s] if ranges[s] is non-null and is fixed at env[s] otherwise.
+	// Plot references are unbounded, and the index of a loop covers all of its values. The
+	// program should already have passed RpnBatch::Compile; one that doesn't gives an unbounded
+	// range.
+	Range Evaluate(const std::vector<RpnInstruction> &program, const RpnEnvironment &env, const Range *const *ranges);
+};
@@ -3,6 +3,7 @@
 #include <sf2d.h>
 #include "BmpFont.h"
 #include "Common.h"
+#include "NumberFormat.h"
 #include "Slider.h"
 
 extern BmpFont mainFont;
@@ -41,19 +42,22 @@ void Slider::Draw(int x, int y, int w, int h)
 	int fillWidth = (int)Interpolate(value, min, max, 0.0f, (float)(w - 2));
 	sf2d_draw_rectangle_gradient(x+1, y+1, w-2, h-2, RGBA8(0xF0, 0xF0, 0xF0, 0xFF), RGBA8(0xFF, 0xFF, 0xFF, 0xFF), SF2D_TOP_TO_BOTTOM);
 	sf2d_draw_rectangle(x+1, y+1, fillWidth, h-2, RGBA8(0x00, 0xCC, 0xFF, 0xFF));
-    mainFont.drawStr(ssprintf("%.5f", value), x + 8, y + h/2 - mainFont.height()/2, RGBA8(0x00, 0x00, 0x00, 0xFF));
+	char valueText[48];
+	FormatFixed(valueText, sizeof(valueText), value, 5);
+    mainFont.drawLayout(mainFont.layoutStr(valueLayout, valueText), x + 8, y + h/2 - mainFont.height()/2, RGBA8(0x00, 0x00, 0x00, 0xFF));
+	BmpFont::flushBatch();
     sf2d_draw_rectangle_gradient(x+1, y+1, w-2, h/2-2, RGBA8(0xFF, 0xFF, 0xFF, 0x20), RGBA8(0xFF, 0xFF, 0xFF, 0x60), SF2D_TOP_TO_BOTTOM);
 }
 
-void Slider::TouchingInside(int x, int y)
+void Slider::TouchPress(int x, int y)
 {
-	Control::TouchingInside(x, y);
+	Control::TouchPress(x, y);
 	TouchingAnywhere(x, y);
 }
 
-void Slider::TouchingOutside(int x, int y)
+void Slider::TouchMove(int x, int y, bool inside)
 {
-	Control::TouchingOutside(x, y);
+	Control::TouchMove(x, y, inside);
 	TouchingAnywhere(x, y);
 }
 
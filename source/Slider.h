@@ -1,10 +1,12 @@
 #pragma once
+#include "BmpFont.h"
 #include "Control.h"
 
 class Slider : public Control
 {
 	float min, max;
 	int width;
+	TextLayout valueLayout;
 	
 	void TouchingAnywhere(int x, int y);
 	
@@ -15,8 +17,8 @@ public:
 	Slider(float min, float max);
 	
 	virtual void Draw(int x, int y, int w, int h);
-	virtual void TouchingInside(int x, int y);
-	virtual void TouchingOutside(int x, int y);
+	virtual void TouchPress(int x, int y);
+	virtual void TouchMove(int x, int y, bool inside);
 	
 	void SetRange(float min, float max);
 	void SetMinimum(float min);
@@ -0,0 +1,165 @@
+#include "SurfacePlot.h"
+#include <sf2d.h>
+#include <algorithm>
+#include <cmath>
+
+// Pixels per unit of the cube, and where its centre goes on the screen
+static constexpr float scale = 80.0f;
+static constexpr float centreX = 200.0f;
+static constexpr float centreY = 120.0f;
+
+SurfacePlot::SurfacePlot()
+{
+	sampled = false;
+	projected = false;
+	projectedYaw = projectedPitch = 0.0f;
+}
+
+RpnInstruction::Status SurfacePlot::Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view)
+{
+	if (sampled && key == this->key) {
+		return RpnInstruction::S_OK;
+	}
+	this->key = key;
+	sampled = false;
+	projected = false;
+	
+	RpnInstruction::Status status = batch.Compile(program);
+	if (status != RpnInstruction::S_OK) {
+		return status;
+	}
+	
+	const int count = SIDE * SIDE;
+	gridX.resize(count);
+	gridY.resize(count);
+	vx.resize(count);
+	vy.resize(count);
+	vz.resize(count);
+	for (int j=0; j<SIDE; j++) {
+		for (int i=0; i<SIDE; i++) {
+			gridX[j * SIDE + i] = view.xmin + (view.xmax - view.xmin) * i / GRID;
+			gridY[j * SIDE + i] = view.ymin + (view.ymax - view.ymin) * j / GRID;
+			vx[j * SIDE + i] = 2.0f * i / GRID - 1;
+			vy[j * SIDE + i] = 2.0f * j / GRID - 1;
+		}
+	}
+	
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = &gridX[0];
+	lanes[RpnEnvironment::VAR_Y] = &gridY[0];
+	batch.Evaluate(env, lanes, count, &vz[0]);
+	
+	// The heights are fitted to the cube, like the y range of a graph fitted to its data
+	float zMin = INFINITY, zMax = -INFINITY;
+	for (float z : vz) {
+		if (std::isfinite(z)) {
+			zMin = std::min(zMin, z);
+			zMax = std::max(zMax, z);
+		}
+	}
+	float middle = (zMin <= zMax) ? (zMin + zMax) / 2 : 0.0f;
+	float half = (zMin < zMax) ? (zMax - zMin) / 2 : 1.0f;
+	for (float &z : vz) {
+		z = std::isfinite(z) ? (z - middle) / half : NAN;
+	}
+	
+	cx.resize(GRID * GRID);
+	cy.resize(GRID * GRID);
+	cz.resize(GRID * GRID);
+	for (int j=0; j<GRID; j++) {
+		for (int i=0; i<GRID; i++) {
+			const int corners[] = { j * SIDE + i, j * SIDE + i + 1, (j + 1) * SIDE + i, (j + 1) * SIDE + i + 1 };
+			float z = 0.0f;
+			int defined = 0;
+			for (int v : corners) {
+				if (!std::isnan(vz[v])) {
+					z += vz[v];
+					++defined;
+				}
+			}
+			int cell = j * GRID + i;
+			cx[cell] = (vx[corners[0]] + vx[corners[1]]) / 2;
+			cy[cell] = (vy[corners[0]] + vy[corners[2]]) / 2;
+			cz[cell] = (defined > 0) ? z / defined : NAN;
+		}
+	}
+	
+	sampled = true;
+	return status;
+}
+
+// Turns the cube by yaw about z, then tilts it by pitch towards the viewer, who looks along y
+// from the front. Every vertex goes through the same 3x3 matrix, one row at a time.
+void SurfacePlot::Project(float yaw, float pitch)
+{
+	float cosYaw = std::cos(yaw), sinYaw = std::sin(yaw);
+	float cosPitch = std::cos(pitch), sinPitch = std::sin(pitch);
+	
+	// Screen x, screen y (going down) and depth (towards the viewer) of a point of the cube;
+	// only the cell centres need a depth
+	const float m00 = scale * cosYaw, m01 = -scale * sinYaw;
+	const float m10 = -scale * sinPitch * sinYaw, m11 = -scale * sinPitch * cosYaw, m12 = -scale * cosPitch;
+	const float m20 = -cosPitch * sinYaw, m21 = -cosPitch * cosYaw, m22 = sinPitch;
+	
+	int count = vx.size();
+	sx.resize(count);
+	sy.resize(count);
+	const float *x = &vx[0], *y = &vy[0], *z = &vz[0];
+	for (int i=0; i<count; i++) {
+		sx[i] = centreX + m00 * x[i] + m01 * y[i];
+	}
+	for (int i=0; i<count; i++) {
+		sy[i] = centreY + m10 * x[i] + m11 * y[i] + m12 * z[i];
+	}
+	
+	int cells = cx.size();
+	cellDepth.resize(cells);
+	for (int c=0; c<cells; c++) {
+		cellDepth[c] = m20 * cx[c] + m21 * cy[c] + m22 * cz[c];
+	}
+	order.clear();
+	for (int c=0; c<cells; c++) {
+		if (!std::isnan(cellDepth[c])) {
+			order.push_back(c);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return cellDepth[a] < cellDepth[b]; });
+	
+	projectedYaw = yaw;
+	projectedPitch = pitch;
+	projected = true;
+}
+
+void SurfacePlot::Draw(float yaw, float pitch, u32 color)
+{
+	if (!sampled) {
+		return;
+	}
+	if (!projected || yaw != projectedYaw || pitch != projectedPitch) {
+		Project(yaw, pitch);
+	}
+	
+	auto edge = [this](int a, int b, u32 color) {
+		if (!std::isnan(sy[a]) && !std::isnan(sy[b])) {
+			sf2d_draw_line(sx[a], sy[a], sx[b], sy[b], 1.0f, color);
+		}
+	};
+	
+	// Each cell draws its edges along the low x and low y sides, and the cells on the far
+	// sides of the grid close it off
+	u32 rgb = color & 0x00FFFFFF;
+	for (int c : order) {
+		// Depth is at most sqrt(3) either way; nearer cells are more opaque
+		float t = std::max(0.0f, std::min(1.0f, (cellDepth[c] + 1.75f) / 3.5f));
+		u32 shade = rgb | ((u32)(0x40 + 0xBF * t) << 24);
+		int i = c % GRID, j = c / GRID, v = j * SIDE + i;
+		edge(v, v + 1, shade);
+		edge(v, v + SIDE, shade);
+		if (i == GRID - 1) {
+			edge(v + 1, v + 1 + SIDE, shade);
+		}
+		if (j == GRID - 1) {
+			edge(v + SIDE, v + SIDE + 1, shade);
+		}
+	}
+}
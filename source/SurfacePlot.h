@@ -0,0 +1,48 @@
+#pragma once
+#include <3ds.h>
+#include <vector>
+#include "InputKey.h"
+#include "RpnBatch.h"
+#include "ViewWindow.h"
+
+// Wireframe of a surface z = f(x, y) over the view's x and y range, seen from a camera that
+// turns about the z axis (yaw) and tilts down towards it (pitch). The heights are sampled on a
+// grid only when the equation, the variables or the view change; turning the camera projects
+// the cached vertices again in one batch, and sorts the cells back to front by the depth of
+// their centres, so the nearer lines are drawn last and darker.
+class SurfacePlot
+{
+public:
+	static constexpr int GRID = 32; // cells along each side
+	static constexpr int SIDE = GRID + 1; // vertices along each side
+	
+private:
+	RpnBatch batch;
+	InputKey key;
+	bool sampled;
+	
+	// Vertices and cell centres scaled to a cube from -1 to 1, NaN where f is undefined; a
+	// cell's centre is the mean of its defined corners
+	std::vector<float> vx, vy, vz;
+	std::vector<float> cx, cy, cz;
+	std::vector<float> gridX, gridY; // graph coordinates of the vertices, for sampling
+	
+	float projectedYaw, projectedPitch;
+	bool projected;
+	std::vector<float> sx, sy; // screen position of each vertex
+	std::vector<float> cellDepth;
+	std::vector<int> order; // defined cells, farthest first
+	
+	void Project(float yaw, float pitch);
+	
+public:
+	SurfacePlot();
+	SurfacePlot(const SurfacePlot&) = delete;
+	SurfacePlot &operator=(const SurfacePlot&) = delete;
+	
+	// Samples the surface again if key (the program's inputs: the variables, the view...)
+	// changed
+	RpnInstruction::Status Update(const std::vector<RpnInstruction> &program, const InputKey &key, const RpnEnvironment &env, const ViewWindow &view);
+	// Projects the mesh again only if the camera turned since the last call
+	void Draw(float yaw, float pitch, u32 color);
+};
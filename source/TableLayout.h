@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include "TableCell.h"
 #include "Common.h"
 
@@ -8,15 +9,110 @@ struct TableLayout
 	int cellWidth, cellHeight;
 	TableCell<_Content> cells[_Rows][_Cols];
 	
+private:
+	// Flattened layout, rebuilt from the spans the first time it's needed after InvalidateLayout().
+	// Every cell starts on a grid unit and covers whole units, so a table of _Rows x _Cols indices
+	// is enough to map any point to its cell exactly. Both tables are sized by the template
+	// parameters; only the spans and cell size are known at runtime.
+	struct LayoutEntry
+	{
+		int row, col;
+		Rect<_CoordType> rect;
+	};
+	
+	mutable LayoutEntry layoutEntries[_Rows * _Cols];
+	mutable int layoutLookup[_Rows][_Cols];
+	mutable int layoutCount;
+	mutable bool layoutValid;
+	
+	void UpdateLayout() const
+	{
+		if (layoutValid) return;
+		
+		for (int r=0; r<_Rows; r++) {
+			for (int c=0; c<_Cols; c++) {
+				layoutLookup[r][c] = -1;
+			}
+		}
+		
+		layoutCount = 0;
+		RectEnumerator iter(const_cast<TableLayout*>(this));
+		TableCell<_Content> *cell;
+		Rect<int> rect;
+		while ((cell = iter.NextCell(rect)) != nullptr) {
+			int offset = cell - &cells[0][0];
+			LayoutEntry &entry = layoutEntries[layoutCount];
+			entry.row = offset / _Cols;
+			entry.col = offset % _Cols;
+			entry.rect = CellToRect(entry.row, entry.col);
+			
+			int rowEnd = std::min(entry.row + cell->rowSpan, _Rows);
+			int colEnd = std::min(entry.col + cell->colSpan, _Cols);
+			for (int r=entry.row; r<rowEnd; r++) {
+				for (int c=entry.col; c<colEnd; c++) {
+					layoutLookup[r][c] = layoutCount;
+				}
+			}
+			
+			++layoutCount;
+		}
+		
+		layoutValid = true;
+	}
+	
+public:
 	TableLayout()
 	{
 		cellWidth = cellHeight = 1;
+		layoutValid = false;
 	}
 	
 	TableLayout(int cellWidth, int cellHeight)
 	{
 		this->cellWidth = cellWidth;
 		this->cellHeight = cellHeight;
+		layoutValid = false;
+	}
+	
+	// Must be called after changing a span or the cell size once the layout has been used.
+	// Changing a cell's content doesn't require this.
+	void InvalidateLayout()
+	{
+		layoutValid = false;
+	}
+	
+	int GetCellCount() const
+	{
+		UpdateLayout();
+		return layoutCount;
+	}
+	
+	TableCell<_Content> *GetCell(int index)
+	{
+		UpdateLayout();
+		return &cells[layoutEntries[index].row][layoutEntries[index].col];
+	}
+	
+	const TableCell<_Content> *GetCell(int index) const
+	{
+		UpdateLayout();
+		return &cells[layoutEntries[index].row][layoutEntries[index].col];
+	}
+	
+	const Rect<_CoordType> &GetCellRect(int index) const
+	{
+		UpdateLayout();
+		return layoutEntries[index].rect;
+	}
+	
+	int CellIndexAtCoords(int x, int y) const
+	{
+		if (x < 0 || y < 0) return -1;
+		int col = x / cellWidth;
+		int row = y / cellHeight;
+		if (row >= _Rows || col >= _Cols) return -1;
+		UpdateLayout();
+		return layoutLookup[row][col];
 	}
 	
 	Rect<_CoordType> CellToRect(int row, int col) const
@@ -52,15 +148,8 @@ struct TableLayout
 	
 	const TableCell<_Content> *CellAtCoords(int x, int y) const
 	{
-		RectEnumerator iter = EnumerateCells();
-		TableCell<_Content> *cell;
-		Rect<int> rect;
-		while ((cell = iter.NextCell(rect)) != nullptr) {
-			if (rect.PointInside(x, y)) {
-				return cell;
-			}
-		}
-		return nullptr;
+		int index = CellIndexAtCoords(x, y);
+		return (index >= 0) ? GetCell(index) : nullptr;
 	}
 	
 	class RectEnumerator
@@ -1,12 +1,14 @@
 #pragma once
 #include <3ds.h>
 #include <string>
+#include "BmpFont.h"
 #include "Control.h"
 
 class TextDisplay : public Control
 {
 	std::string text;
 	u32 textColor;
+	TextLayout layout;
 	
 public:
 	TextDisplay();
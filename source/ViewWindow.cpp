@@ -1,4 +1,5 @@
 #include "ViewWindow.h"
+#include <algorithm>
 
 ViewWindow::ViewWindow(float xMin, float xMax, float yMin, float yMax)
 {
@@ -6,12 +7,26 @@ ViewWindow::ViewWindow(float xMin, float xMax, float yMin, float yMax)
 	xmax = xMax;
 	ymin = yMin;
 	ymax = yMax;
+	UpdateTransform();
+}
+
+void ViewWindow::UpdateTransform()
+{
+	scaleX = (sxmax - sxmin) / (xmax - xmin);
+	offsetX = sxmin - xmin * scaleX;
+	scaleY = (symax - symin) / (ymax - ymin);
+	offsetY = symin - ymin * scaleY;
+	
+	invScaleX = (xmax - xmin) / (sxmax - sxmin);
+	invOffsetX = xmin - sxmin * invScaleX;
+	invScaleY = (ymax - ymin) / (symax - symin);
+	invOffsetY = ymin - symin * invScaleY;
 }
 
 Point<int> ViewWindow::GetScreenCoords(float x, float y) const
 {
-	int sx = (int)Interpolate(x, xmin, xmax, sxmin, sxmax);
-	int sy = (int)Interpolate(y, ymin, ymax, symin, symax);
+	int sx = (int)(x * scaleX + offsetX);
+	int sy = (int)(y * scaleY + offsetY);
 	return Point<int>(sx, sy);
 }
 
@@ -22,8 +37,8 @@ Point<int> ViewWindow::GetScreenCoords(Point<float> point) const
 
 Point<float> ViewWindow::GetGraphCoords(int x, int y) const
 {
-	float gx = Interpolate((float)x, sxmin, sxmax, xmin, xmax);
-	float gy = Interpolate((float)y, symin, symax, ymin, ymax);
+	float gx = x * invScaleX + invOffsetX;
+	float gy = y * invScaleY + invOffsetY;
 	return Point<float>(gx, gy);
 }
 
@@ -32,12 +47,63 @@ Point<float> ViewWindow::GetGraphCoords(Point<int> point) const
 	return GetGraphCoords(point.x, point.y);
 }
 
+// Graph x of each screen column from 0 to count - 1
+void ViewWindow::GetColumnX(float *out, int count) const
+{
+	for (int i=0; i<count; i++) {
+		out[i] = i * invScaleX + invOffsetX;
+	}
+}
+
+static void MapAffine(const float *in, float *out, int count, float scale, float offset)
+{
+	for (int i=0; i<count; i++) {
+		out[i] = in[i] * scale + offset;
+	}
+}
+
+static void MapAffineFixed(const float *in, s32 *out, int count, float scale, float offset, int fracBits)
+{
+	// Far enough off the screen that clamping doesn't visibly bend a line going there
+	const float limit = 16384.0f;
+	const float one = (float)(1 << fracBits);
+	const float lo = -limit * one, hi = limit * one;
+	scale *= one;
+	offset *= one;
+	
+	for (int i=0; i<count; i++) {
+		float s = std::min(std::max(in[i] * scale + offset, lo), hi);
+		out[i] = (in[i] - in[i] == 0) ? (s32)s : ViewWindow::UNDEFINED_COORD;
+	}
+}
+
+void ViewWindow::MapToScreenX(const float *xs, float *out, int count) const
+{
+	MapAffine(xs, out, count, scaleX, offsetX);
+}
+
+void ViewWindow::MapToScreenY(const float *ys, float *out, int count) const
+{
+	MapAffine(ys, out, count, scaleY, offsetY);
+}
+
+void ViewWindow::MapToScreenX(const float *xs, s32 *out, int count, int fracBits) const
+{
+	MapAffineFixed(xs, out, count, scaleX, offsetX, fracBits);
+}
+
+void ViewWindow::MapToScreenY(const float *ys, s32 *out, int count, int fracBits) const
+{
+	MapAffineFixed(ys, out, count, scaleY, offsetY, fracBits);
+}
+
 void ViewWindow::Pan(float x, float y)
 {
 	xmin += x;
 	xmax += x;
 	ymin += y;
 	ymax += y;
+	UpdateTransform();
 }
 
 void ViewWindow::ZoomIn(float factor)
@@ -53,4 +119,5 @@ void ViewWindow::ZoomOut(float factor)
 	xmax = Interpolate(factor, 1.0f, 0.0f, xmax, centerX);
 	ymin = Interpolate(factor, 1.0f, 0.0f, ymin, centerY);
 	ymax = Interpolate(factor, 1.0f, 0.0f, ymax, centerY);
+	UpdateTransform();
 }
\ No newline at end of file
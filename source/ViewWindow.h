@@ -1,4 +1,5 @@
 #pragma once
+#include <3ds.h>
 #include "Common.h"
 
 class ViewWindow
@@ -8,7 +9,19 @@ class ViewWindow
 	static constexpr float symin = 239.0f;
 	static constexpr float symax = 0.0f;
 	
+	// screen = graph * scale + offset, and the other way around; only recomputed when the
+	// bounds change
+	float scaleX, offsetX, scaleY, offsetY;
+	float invScaleX, invOffsetX, invScaleY, invOffsetY;
+	
+	void UpdateTransform();
+	
 public:
+	// Written by the fixed point MapToScreen functions for values that are undefined (NaN) or
+	// infinite
+	static constexpr s32 UNDEFINED_COORD = -0x7FFFFFFF - 1;
+	
+	// Read-only; change them with Pan, ZoomIn and ZoomOut so the transform stays in sync
 	float xmin, xmax;
 	float ymin, ymax;
 	
@@ -19,7 +32,16 @@ public:
 	Point<float> GetGraphCoords(int x, int y) const;
 	Point<float> GetGraphCoords(Point<int> point) const;
 	
+	// Batch versions for whole arrays of samples
+	void GetColumnX(float *out, int count) const;
+	void MapToScreenX(const float *xs, float *out, int count) const;
+	void MapToScreenY(const float *ys, float *out, int count) const;
+	// Fixed point screen coordinates with fracBits fractional bits (0 for whole pixels). Values
+	// far off the screen are clamped, so the results always fit.
+	void MapToScreenX(const float *xs, s32 *out, int count, int fracBits = 0) const;
+	void MapToScreenY(const float *ys, s32 *out, int count, int fracBits = 0) const;
+	
 	void Pan(float x, float y);
 	void ZoomIn(float factor);
 	void ZoomOut(float factor);
-};
\ No newline at end of file
+};
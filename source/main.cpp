@@ -2,25 +2,54 @@
 #include <sf2d.h>
 #include <sftd.h>
 #include <vector>
+#include <algorithm>
 #include <cmath>
-#include <sstream>
 #include "ViewWindow.h"
 #include "BmpFont.h"
+#include "GlyphBatch.h"
 #include "RpnInstruction.h"
+#include "RpnBatch.h"
+#include "RpnComplex.h"
+#include "RpnInterval.h"
 #include "TableLayout.h"
 #include "ControlGrid.h"
 #include "Button.h"
-#include "TextDisplay.h"
+#include "EquationDisplay.h"
 #include "NumpadController.h"
+#include "NumberFormat.h"
 #include "Slider.h"
+#include "Plot.h"
+#include "CurveSampler.h"
+#include "ImplicitPlotter.h"
+#include "OdeSolver.h"
+#include "Integrator.h"
 
-constexpr int plotCount = 4;
+constexpr int maxLayers = 8; // render targets are big, so only this many plots get one
 
-std::vector<RpnInstruction> equations[plotCount];
-float exprX;
+std::vector<std::unique_ptr<Plot>> plots;
+RpnEnvironment env;
+Slider *varSliders[4];
+RpnBatch plotBatch;
+CurveSampler curveSampler;
+ImplicitPlotter implicitPlotter;
+OdeSolver odeSolver;
+Integrator integrator;
+RpnComplex complexEvaluator; // for trace mode
+const std::size_t maxOdeStarts = 32;
+float columnX[400]; // graph x of each screen column in this frame
+float samples[400];
+std::vector<const float*> plotLanes; // each plot's samples, for plots that read other plots
+std::vector<int> plotOrder; // plots sorted so the ones that are referenced come first
+std::vector<ReferenceStatus> plotReferences; // R_CYCLE or R_DANGLING for plots with broken references
+int familySlot = -1; // slider swept by family mode, or -1 when it's off
+int familyCount = 16;
+bool showContours = true;
+float surfaceYaw = 0.6f, surfacePitch = 0.5f; // camera of surface plots, in radians
 BmpFont mainFont, btnFont;
-TextDisplay *equDisp;
+GlyphBatch glyphBatch;
+EquationDisplay *equDisp;
 Control *btnBackspace;
+Button *btnPlotType;
 NumpadController numpad;
 std::vector<ControlGridBase*> controlGrids;
 int cgridIndex = 0;
@@ -29,11 +58,16 @@ int keys = 0, down = 0;
 bool altMode = false;
 ViewWindow view(-5.0f, 5.0f, -3.0f, 3.0f);
 
-const int plotColors[] = { RGBA8(0x00, 0x00, 0xC0, 0xFF), RGBA8(0x00, 0x80, 0x00, 0xFF), RGBA8(0xD5, 0x00, 0xDD, 0xFF), RGBA8(0xD2, 0x94, 0x00, 0xFF) };
+const int plotColors[] = {
+	RGBA8(0x00, 0x00, 0xC0, 0xFF), RGBA8(0x00, 0x80, 0x00, 0xFF), RGBA8(0xD5, 0x00, 0xDD, 0xFF), RGBA8(0xD2, 0x94, 0x00, 0xFF),
+	RGBA8(0xC0, 0x00, 0x00, 0xFF), RGBA8(0x00, 0x90, 0x90, 0xFF), RGBA8(0x60, 0x30, 0x00, 0xFF), RGBA8(0x50, 0x50, 0x50, 0xFF)
+};
 
 void UpdateEquationDisplay();
+const char *LastTokenText();
 void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid);
 void SetUpVarsControlGrid(ControlGrid<5, 7> &cgrid);
+void SetUpPlotsControlGrid(ControlGrid<5, 7> &cgrid);
 
 void drawAxes(const ViewWindow &view, u32 color, float originX = 0.0f, float originY = 0.0f, bool hideHorizontal = false)
 {
@@ -46,35 +80,433 @@ void drawAxes(const ViewWindow &view, u32 color, float originX = 0.0f, float ori
 	}
 }
 
-void drawGraph(const std::vector<RpnInstruction> &equation, const ViewWindow &view, u32 color, bool showErrors = true)
+// Draws one sample per screen column, leaving gaps where the value is undefined
+void drawSamples(const float *ys, const ViewWindow &view, u32 color, float width = 2.0f)
 {
-	Point<int> lastPoint;
-	bool ignoreLastPoint = true;
-	
-	for (int x=0; x<400; x++) {
-		Point<int> pt;
-		exprX = Interpolate((float)x, 0.0f, 399.0f, view.xmin, view.xmax);
-		float y;
-		RpnInstruction::Status status = ExecuteRpn(equation, y);
-		pt = view.GetScreenCoords(exprX, y);
+	s32 sy[400];
+	view.MapToScreenY(ys, sy, 400);
+	
+	for (int x=1; x<400; x++) {
+		if (sy[x - 1] != ViewWindow::UNDEFINED_COORD && sy[x] != ViewWindow::UNDEFINED_COORD) {
+			sf2d_draw_line(x - 1, sy[x - 1], x, sy[x], width, color);
+		}
+	}
+}
+
+// Draws the points of a parametric or polar curve, leaving gaps at the breaks
+void drawCurve(const std::vector<float> &xs, const std::vector<float> &ys, const ViewWindow &view, u32 color, float width = 2.0f)
+{
+	static std::vector<s32> sx, sy;
+	int count = xs.size();
+	sx.resize(count);
+	sy.resize(count);
+	if (count < 2) {
+		return;
+	}
+	
+	view.MapToScreenX(&xs[0], &sx[0], count);
+	view.MapToScreenY(&ys[0], &sy[0], count);
+	
+	for (int i=1; i<count; i++) {
+		if (sx[i - 1] != ViewWindow::UNDEFINED_COORD && sy[i - 1] != ViewWindow::UNDEFINED_COORD &&
+			sx[i] != ViewWindow::UNDEFINED_COORD && sy[i] != ViewWindow::UNDEFINED_COORD) {
+			sf2d_draw_line(sx[i - 1], sy[i - 1], sx[i], sy[i], width, color);
+		}
+	}
+}
+
+void drawPlot(const Plot &plot, const ViewWindow &view)
+{
+	if (plot.type == Plot::T_FUNCTION || plot.type == Plot::T_INTEGRAL) {
+		drawSamples(plot.samples, view, plot.color);
+	} else if (plot.type == Plot::T_ODE) {
+		drawCurve(plot.fieldX, plot.fieldY, view, (plot.color & 0x00FFFFFF) | 0x60000000, 1.0f);
+		drawCurve(plot.curveX, plot.curveY, view, plot.color);
+	} else {
+		drawCurve(plot.curveX, plot.curveY, view, plot.color);
+	}
+}
+
+const char *plotTypeName(Plot::Type type)
+{
+	switch (type) {
+		case Plot::T_PARAMETRIC: return "x,y(t)";
+		case Plot::T_POLAR: return "r(t)";
+		case Plot::T_IMPLICIT: return "f(x,y)";
+		case Plot::T_HEATMAP: return "heat";
+		case Plot::T_ODE: return "y'=f";
+		case Plot::T_ITERATED: return "y->f";
+		case Plot::T_INTEGRAL: return "int y";
+		case Plot::T_COMPLEX: return "f(z)";
+		case Plot::T_SURFACE: return "z(x,y)";
+		default: return "y(x)";
+	}
+}
+
+// Fills an integral plot's samples with the running integral of the integrand samples, from the
+// column nearest the origin. An origin on the screen is at most half a column from there, which
+// the sample covers; one off the screen takes a definite integral up to the edge.
+void integrateColumns(Plot &plot, const float *integrand)
+{
+	float origin = std::isnan(plot.integralFrom) ? 0.0f : plot.integralFrom;
+	float column = (origin - columnX[0]) / (columnX[1] - columnX[0]);
+	float anchorValue, error;
+	int anchor;
+	if (column > -0.5f && column < Plot::COLUMNS - 0.5f) {
+		anchor = (int)std::round(column);
+		anchorValue = (columnX[anchor] - origin) * integrand[anchor];
+	} else {
+		anchor = (column < 0) ? 0 : Plot::COLUMNS - 1;
+		if (integrator.Integrate(plot.hoisted, env, origin, columnX[anchor], anchorValue, error) != RpnInstruction::S_OK) {
+			anchorValue = NAN;
+		}
+	}
+	Integrator::RunningIntegral(columnX, integrand, Plot::COLUMNS, anchor, anchorValue, plot.samples);
+}
+
+// Writes the error bound of an integral after a plus-minus sign, rounded up to two significant
+// digits
+void formatError(char *out, int size, float error)
+{
+	int precision = 0;
+	if (error > 0) {
+		precision = std::max(0, std::min(9, 1 - (int)std::floor(std::log10(error))));
+	}
+	float scale = std::pow(10.0f, (float)precision);
+	out[0] = '\xB1';
+	FormatFixed(out + 1, size - 1, std::ceil(error * scale) / scale, precision);
+}
+
+// Writes re + im i, e.g. "1.50000 - 2.00000i"
+void formatComplex(char *out, int size, float re, float im)
+{
+	int length = FormatFixed(out, size, re, 5);
+	if (length + 4 < size) {
+		out[length++] = ' ';
+		out[length++] = (im < 0) ? '-' : '+';
+		out[length++] = ' ';
+		length += FormatFixed(out + length, size - length, std::abs(im), 5);
+		if (length + 1 < size) {
+			out[length++] = 'i';
+			out[length] = '\0';
+		}
+	}
+}
+
+// Whether a function plot can come within a pixel of the screen over the view's x range, going
+// by the bounds of its values in interval arithmetic. Plot references are unbounded, so a plot
+// that reads others always can.
+bool mayBeOnScreen(const Plot &plot)
+{
+	static RpnInterval interval;
+	RpnInterval::Range xRange = { view.xmin, view.xmax };
+	const RpnInterval::Range *ranges[RpnEnvironment::SLOT_COUNT] = {};
+	ranges[RpnEnvironment::VAR_X] = &xRange;
+	
+	RpnInterval::Range y = interval.Evaluate(plot.equation, env, ranges);
+	float margin = (view.ymax - view.ymin) / 240;
+	return !y.IsEmpty() && y.hi >= view.ymin - margin && y.lo <= view.ymax + margin;
+}
+
+// Samples every plot at each column. Plots read by others are sampled first, so a reference
+// just reads the samples that are already there instead of evaluating the plot again. A plot
+// is only sampled again when its equation, the view, or a variable or plot it reads changed,
+// and function plots that are off the screen aren't sampled unless a plot that is reads them.
+void samplePlots()
+{
+	static std::vector<const std::vector<RpnInstruction>*> programs;
+	static InputKey viewKey;
+	programs.clear();
+	plotLanes.clear();
+	for (auto &plot : plots) {
+		programs.push_back(&plot->equation);
+		plotLanes.push_back(plot->samples);
+	}
+	OrderByReferences(programs, plotOrder, plotReferences);
+	env.plotCount = plots.size();
+	
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = columnX;
+	const float bounds[] = { view.xmin, view.xmax, view.ymin, view.ymax };
+	
+	for (std::size_t i=0; i<plots.size(); i++) {
+		if (plotReferences[i] != R_OK) {
+			Plot &plot = *plots[i];
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			plot.UpdateBounds();
+			plot.samplesValid = false;
+		}
+	}
+	
+	// Readers come after the plots they read, so going backwards, a plot's readers have all
+	// decided whether they need it by the time it's checked
+	static std::vector<bool> needed;
+	needed.assign(plots.size(), false);
+	for (auto it = plotOrder.rbegin(); it != plotOrder.rend(); ++it) {
+		const Plot &plot = *plots[*it];
+		if (!needed[*it] && (plot.type != Plot::T_FUNCTION || mayBeOnScreen(plot))) {
+			needed[*it] = true;
+		}
+		if (needed[*it]) {
+			for (const RpnInstruction &inst : plot.equation) {
+				if (inst.GetPlot() >= 0) {
+					needed[inst.GetPlot()] = true;
+				}
+			}
+		}
+	}
+	
+	for (int i : plotOrder) {
+		Plot &plot = *plots[i];
 		
-		if (status == RpnInstruction::S_OK && !ignoreLastPoint) {
-			sf2d_draw_line(lastPoint.x, lastPoint.y, pt.x, pt.y, 2.0f, color);
-		} else if (status == RpnInstruction::S_OVERFLOW) {
-			if (showErrors) {
-                mainFont.drawStr("Error: Stack overflow", 4, 4, color);
+		// A referenced plot's key goes in whole, so the key covers its inputs too
+		InputKey &key = plot.key;
+		key.Clear();
+		key.Add(&plot.revision, sizeof(u32));
+		for (const RpnInstruction &inst : plot.equation) {
+			if (inst.GetSlot() >= 0) {
+				key.Add(&env.values[inst.GetSlot()], sizeof(float));
+			} else if (inst.GetPlot() >= 0) {
+				key.Add(plots[inst.GetPlot()]->key);
 			}
-			break;
-		} else if (status == RpnInstruction::S_UNDERFLOW) {
-			if (showErrors) {
-                mainFont.drawStr("Error: Stack underflow", 4, 4, color);
+		}
+		plot.fieldKey = key;
+		key.Add(bounds, sizeof(bounds));
+		viewKey = key;
+		if (plot.type == Plot::T_INTEGRAL) {
+			key.Add(&plot.integralFrom, sizeof(float));
+		}
+		if (!plot.startX.empty()) {
+			key.Add(&plot.startX[0], plot.startX.size() * sizeof(float));
+			key.Add(&plot.startY[0], plot.startY.size() * sizeof(float));
+		}
+		plot.layerKey = key;
+		plot.layerKey.Add(&plot.color, sizeof(plot.color));
+		
+		if (plot.samplesValid && plot.sampledKey == key) {
+			continue;
+		}
+		
+		if (!needed[i]) {
+			// Left unsampled, so the plot is sampled as soon as it's needed, even with the same key
+			if (plot.samplesValid) {
+				std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+				plot.UpdateBounds();
+				plot.samplesValid = false;
 			}
-			break;
-		} else {
-			ignoreLastPoint = (status == RpnInstruction::S_UNDEFINED);
+			int depth;
+			plot.status = CheckProgram(plot.equation, 1, depth);
+			continue;
 		}
 		
-		lastPoint = pt;
+		if (plot.equation.empty()) {
+			// Nothing to evaluate, but plots that read this one need to see it's undefined
+			plot.status = RpnInstruction::S_UNDERFLOW;
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			plot.curveX.clear();
+			plot.curveY.clear();
+		} else if (plot.type == Plot::T_HEATMAP || plot.type == Plot::T_ITERATED || plot.type == Plot::T_COMPLEX || plot.type == Plot::T_SURFACE) {
+			// Evaluated in updateHeatmaps, updateIteratedMaps and updateSurfaces
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			plot.curveX.clear();
+			plot.curveY.clear();
+			if (plot.type == Plot::T_COMPLEX) {
+				// Hoisting evaluates in real numbers, where e.g. the i in "-1 sqrt" is undefined
+				plot.hoisted = plot.equation;
+			} else {
+				HoistInvariants(plot.equation, env, (1u << RpnEnvironment::VAR_X) | (1u << RpnEnvironment::VAR_Y), plot.hoisted);
+			}
+			plot.status = plotBatch.Compile(plot.hoisted);
+		} else if (plot.type == Plot::T_ODE) {
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			HoistInvariants(plot.equation, env, (1u << RpnEnvironment::VAR_X) | (1u << RpnEnvironment::VAR_Y), plot.hoisted);
+			// Adding a starting point leaves the slope field as it is
+			if (plot.slopeKey != viewKey) {
+				odeSolver.SlopeField(plot.hoisted, env, view, plot.fieldX, plot.fieldY);
+				plot.slopeKey = viewKey;
+			}
+			plot.status = odeSolver.Solve(plot.hoisted, env, view, plot.startX, plot.startY, plot.curveX, plot.curveY);
+		} else if (plot.type == Plot::T_IMPLICIT) {
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			HoistInvariants(plot.equation, env, (1u << RpnEnvironment::VAR_X) | (1u << RpnEnvironment::VAR_Y), plot.hoisted);
+			plot.status = implicitPlotter.Plot(plot.hoisted, env, view, plot.curveX, plot.curveY);
+		} else if (plot.type == Plot::T_INTEGRAL) {
+			HoistInvariants(plot.equation, env, 1u << RpnEnvironment::VAR_X, plot.hoisted);
+			plot.status = plotBatch.Compile(plot.hoisted);
+			plotBatch.Evaluate(env, lanes, Plot::COLUMNS, samples, &plotLanes[0]);
+			integrateColumns(plot, samples);
+		} else if (plot.type != Plot::T_FUNCTION) {
+			// Curves don't have a value at each x for other plots to read
+			std::fill(plot.samples, plot.samples + Plot::COLUMNS, NAN);
+			HoistInvariants(plot.equation, env, 1u << RpnEnvironment::VAR_T, plot.hoisted);
+			CurveSampler::Mode mode = (plot.type == Plot::T_POLAR) ? CurveSampler::M_POLAR : CurveSampler::M_PARAMETRIC;
+			plot.status = curveSampler.Sample(plot.hoisted, mode, plot.tMin, plot.tMax, env, view, plot.curveX, plot.curveY, &plotLanes[0]);
+		} else {
+			HoistInvariants(plot.equation, env, 1u << RpnEnvironment::VAR_X, plot.hoisted);
+			plot.status = plotBatch.Compile(plot.hoisted);
+			plotBatch.Evaluate(env, lanes, Plot::COLUMNS, plot.samples, &plotLanes[0]);
+		}
+		plot.UpdateBounds();
+		plot.sampledKey = key;
+		plot.samplesValid = true;
+	}
+}
+
+// Brings the tiles of the heatmap and complex plots up to date; this runs every frame, since
+// tiles are evaluated a few at a time and panning brings new ones into view
+void updateHeatmaps()
+{
+	for (std::size_t i=0; i<plots.size(); i++) {
+		Plot &plot = *plots[i];
+		if (plot.type != Plot::T_HEATMAP && plot.type != Plot::T_COMPLEX) {
+			plot.heatmap.reset();
+			continue;
+		}
+		if (plotReferences[i] != R_OK || plot.status != RpnInstruction::S_OK) {
+			continue;
+		}
+		if (!plot.heatmap) {
+			plot.heatmap.reset(new Heatmap());
+		}
+		Heatmap::Mode mode = (plot.type == Plot::T_COMPLEX) ? Heatmap::M_COMPLEX : Heatmap::M_VALUE;
+		plot.heatmap->Update(plot.hoisted, plot.fieldKey, env, view, showContours, mode);
+	}
+}
+
+// Runs this frame's iterations of the iterated map plots
+void updateIteratedMaps()
+{
+	for (std::size_t i=0; i<plots.size(); i++) {
+		Plot &plot = *plots[i];
+		if (plot.type != Plot::T_ITERATED) {
+			plot.iterated.reset();
+			continue;
+		}
+		if (plotReferences[i] != R_OK || plot.status != RpnInstruction::S_OK) {
+			continue;
+		}
+		if (!plot.iterated) {
+			plot.iterated.reset(new IteratedMap());
+		}
+		plot.iterated->Update(plot.hoisted, plot.layerKey, env, view, columnX, plot.color);
+	}
+}
+
+// Samples the selected surface plot again if its key changed. Only the selected plot is
+// drawn, so the others keep their mesh until they're selected and their key is checked.
+void updateSurfaces()
+{
+	for (std::size_t i=0; i<plots.size(); i++) {
+		Plot &plot = *plots[i];
+		if (plot.type != Plot::T_SURFACE) {
+			plot.surface.reset();
+		} else if ((int)i == plotIndex && plotReferences[i] == R_OK && plot.status == RpnInstruction::S_OK) {
+			if (!plot.surface) {
+				plot.surface.reset(new SurfacePlot());
+			}
+			plot.surface->Update(plot.hoisted, plot.key, env, view);
+		}
+	}
+}
+
+// Draws the curves that changed into their layers; has to happen before the top screen's frame.
+// Plots that are off-screen give their layer up, so the layers go to the curves that are shown.
+void renderLayers()
+{
+	int layerCount = 0;
+	for (auto &plot : plots) {
+		if (plot->layer && !plot->IsVisible(view)) {
+			plot->layer.reset();
+		}
+		if (plot->layer) {
+			++layerCount;
+		}
+	}
+	
+	for (int i : plotOrder) {
+		Plot &plot = *plots[i];
+		if (!plot.IsVisible(view)) {
+			continue;
+		}
+		if (!plot.layer) {
+			if (layerCount >= maxLayers) {
+				continue;
+			}
+			plot.layer.reset(new PlotLayer());
+			++layerCount;
+		}
+		if (!plot.layer->IsCurrent(plot.layerKey) && plot.layer->Begin(plot.layerKey)) {
+			drawPlot(plot, view);
+			plot.layer->End();
+		}
+	}
+}
+
+void drawGraph(int index, const ViewWindow &view, bool showErrors = true)
+{
+	const Plot &plot = *plots[index];
+	RpnInstruction::Status status = plot.status;
+	u32 color = plot.color;
+	
+	if (plotReferences[index] == R_CYCLE) {
+		if (showErrors) {
+            mainFont.drawStr("Error: Circular reference", 4, 4, color);
+		}
+	} else if (plotReferences[index] == R_DANGLING) {
+		if (showErrors) {
+            mainFont.drawStr("Error: Undefined reference", 4, 4, color);
+		}
+	} else if (status == RpnInstruction::S_OVERFLOW) {
+		if (showErrors) {
+            mainFont.drawStr("Error: Stack overflow", 4, 4, color);
+		}
+	} else if (status == RpnInstruction::S_UNDERFLOW) {
+		if (showErrors) {
+            mainFont.drawStr("Error: Stack underflow", 4, 4, color);
+		}
+	} else if (plot.IsVisible(view)) {
+		if (plot.layer && plot.layer->IsCurrent(plot.layerKey)) {
+			plot.layer->Draw();
+		} else {
+			drawPlot(plot, view);
+		}
+	}
+}
+
+// Draws the equation for count values of a slot between min and max as faint curves. The parts
+// that only depend on x are computed once and shared by all the curves.
+void drawFamily(const std::vector<RpnInstruction> &equation, int slot, float min, float max, int count, const ViewWindow &view, u32 color)
+{
+	static std::vector<RpnInstruction> folded, outer;
+	static std::vector<std::vector<RpnInstruction>> temps;
+	static std::vector<float> tempValues;
+	
+	const unsigned xSlot = 1u << RpnEnvironment::VAR_X;
+	HoistInvariants(equation, env, xSlot | (1u << slot), folded);
+	HoistColumnWork(folded, xSlot, RpnEnvironment::TEMP_FIRST, outer, temps);
+	
+	const float *lanes[RpnEnvironment::SLOT_COUNT] = {};
+	lanes[RpnEnvironment::VAR_X] = columnX;
+	
+	tempValues.resize(temps.size() * 400);
+	for (std::size_t k=0; k<temps.size(); k++) {
+		plotBatch.Compile(temps[k]);
+		plotBatch.Evaluate(env, lanes, 400, &tempValues[k * 400], &plotLanes[0]);
+	}
+	for (std::size_t k=0; k<temps.size(); k++) {
+		lanes[RpnEnvironment::TEMP_FIRST + k] = &tempValues[k * 400];
+	}
+	
+	if (plotBatch.Compile(outer) != RpnInstruction::S_OK) {
+		return;
+	}
+	
+	RpnEnvironment familyEnv = env;
+	u32 faintColor = (color & 0x00FFFFFF) | 0x60000000;
+	for (int i=0; i<count; i++) {
+		familyEnv[slot] = (count > 1) ? Interpolate((float)i, 0.0f, (float)(count - 1), min, max) : min;
+		plotBatch.Evaluate(familyEnv, lanes, 400, samples, &plotLanes[0]);
+		drawSamples(samples, view, faintColor, 1.0f);
 	}
 }
 
@@ -97,19 +529,196 @@ void addInstruction(const RpnInstruction &inst)
 {
 	if (numpad.EntryInProgress()) {
 		numpad.Reset();
+		equDisp->ReplaceLast(LastTokenText());
 	}
-	equations[plotIndex].push_back(inst);
-	UpdateEquationDisplay();
+	plots[plotIndex]->equation.push_back(inst);
+	plots[plotIndex]->Edited();
+	equDisp->Push(LastTokenText());
 }
 
-int main(int argc, char *argv[])
+// Removes a plot. References to the plots after it are renumbered, and references to it are
+// left pointing nowhere, which shows an undefined reference error on the plots that had them.
+void deletePlot(int index)
+{
+	plots.erase(plots.begin() + index);
+	
+	for (auto &plot : plots) {
+		bool changed = false;
+		for (RpnInstruction &inst : plot->equation) {
+			int ref = inst.GetPlot();
+			if (ref == index) {
+				inst = RpnInstruction(RpnInstruction::OP_PUSHPLOT, -1);
+				changed = true;
+			} else if (ref > index) {
+				inst = RpnInstruction(RpnInstruction::OP_PUSHPLOT, ref - 1);
+				changed = true;
+			}
+		}
+		if (changed) {
+			plot->Edited();
+		}
+	}
+	
+	if (plotIndex >= (int)plots.size()) {
+		plotIndex = plots.size() - 1;
+	}
+}
+
+// Draws the 2D graphs on the top screen: heatmaps, axes, curves, and the cursor with the trace
+// readouts when X or Y is held
+void drawGraphScreen(float cursorX, float cursorY)
 {
-	float cursorX = 200.0f, cursorY = 120.0f;
 	float traceUnit = 0;
 	bool traceUndefined = false;
+	bool traceIntegral = false; // whether there's a definite integral to show
+	float traceError = 0, integral = 0, integralError = 0;
+	bool traceComplex = false; // whether there's a complex value to show
+	float traceRe = 0, traceIm = 0;
+	static TextLayout traceLayoutX, traceLayoutY, traceLayoutIntegral, traceLayoutComplex;
+	
+	for (auto &plot : plots) {
+		if (plot->heatmap) {
+			plot->heatmap->Draw(view);
+		}
+	}
+	drawAxes(view, RGBA8(0x80, 0xFF, 0xFF, 0xFF));
+	for (auto &plot : plots) {
+		if (plot->iterated) {
+			plot->iterated->Draw();
+		}
+	}
+	
+	if (familySlot >= 0 && plots[plotIndex]->type == Plot::T_FUNCTION) {
+		Slider *slider = varSliders[familySlot - RpnEnvironment::VAR_A];
+		drawFamily(plots[plotIndex]->equation, familySlot, slider->GetMinimum(), slider->GetMaximum(), familyCount, view, plots[plotIndex]->color);
+	}
+	
+	for (std::size_t i=0; i<plots.size(); i++) {
+		drawGraph(i, view, (int)i == plotIndex);
+		// The later graphs go over the error message, if there is one
+		if ((int)i == plotIndex) glyphBatch.Flush();
+	}
+	
+	if (keys & (KEY_X | KEY_Y)) {
+		Point<float> cursor = view.GetGraphCoords(cursorX, cursorY);
+		if (keys & KEY_Y) {
+			if (keys & KEY_B) {
+				traceUnit = std::pow(10.0f, std::ceil(std::log10((view.xmax - view.xmin) / 400)));
+				cursor.x = std::round(cursor.x / traceUnit) * traceUnit;
+			}
+			// A marks where definite integrals start, or takes the mark away
+			Plot &plot = *plots[plotIndex];
+			if (down & KEY_A) {
+				plot.integralFrom = std::isnan(plot.integralFrom) ? cursor.x : NAN;
+			}
+			
+			// Evaluate the plots this one reads at the cursor too, in the same order
+			static std::vector<float> traceValues;
+			traceValues.assign(plots.size(), NAN);
+			RpnEnvironment traceEnv = env;
+			traceEnv[RpnEnvironment::VAR_X] = cursor.x;
+			traceEnv.plotValues = &traceValues[0];
+			for (int i : plotOrder) {
+				float y, error;
+				if (plots[i]->type == Plot::T_INTEGRAL) {
+					float from = std::isnan(plots[i]->integralFrom) ? 0.0f : plots[i]->integralFrom;
+					if (plots[i]->status == RpnInstruction::S_OK &&
+						integrator.Integrate(plots[i]->hoisted, env, from, cursor.x, y, error) == RpnInstruction::S_OK) {
+						traceValues[i] = y;
+						traceError = (i == plotIndex) ? error : traceError;
+					}
+				} else if (ExecuteRpn(plots[i]->equation, traceEnv, y) == RpnInstruction::S_OK) {
+					traceValues[i] = y;
+				}
+			}
+			traceUndefined = std::isnan(traceValues[plotIndex]) && plot.type != Plot::T_COMPLEX;
+			if (!traceUndefined && plot.type != Plot::T_COMPLEX) {
+				cursor.y = traceValues[plotIndex];
+			}
+			
+			// Complex plots show f at z = x + yi under the cursor, and functions show their
+			// complex value where they're undefined on the reals
+			traceComplex = false;
+			if (plot.type == Plot::T_COMPLEX || (plot.type == Plot::T_FUNCTION && traceUndefined)) {
+				float re = cursor.x, im = (plot.type == Plot::T_COMPLEX) ? cursor.y : 0.0f;
+				const float *laneRe[RpnEnvironment::SLOT_COUNT] = {}, *laneIm[RpnEnvironment::SLOT_COUNT] = {};
+				laneRe[RpnEnvironment::VAR_X] = &re;
+				laneIm[RpnEnvironment::VAR_X] = &im;
+				if (complexEvaluator.Compile(plot.equation) == RpnInstruction::S_OK) {
+					complexEvaluator.Evaluate(env, laneRe, laneIm, 1, &traceRe, &traceIm);
+					traceComplex = !std::isnan(traceRe);
+				}
+			}
+			
+			traceIntegral = false;
+			if (plot.type == Plot::T_FUNCTION && !std::isnan(plot.integralFrom) && plot.status == RpnInstruction::S_OK) {
+				traceIntegral = integrator.Integrate(plot.hoisted, env, plot.integralFrom, cursor.x, integral, integralError) == RpnInstruction::S_OK;
+			}
+			if (!std::isnan(plot.integralFrom)) {
+				Point<int> mark = view.GetScreenCoords(plot.integralFrom, 0.0f);
+				if (0 <= mark.x && mark.x < 400) {
+					sf2d_draw_rectangle(mark.x, 0, 1, 240, RGBA8(0xFF, 0x80, 0x80, 0xFF));
+				}
+			}
+		} else {
+			traceUndefined = false;
+			traceIntegral = false;
+			traceComplex = false;
+		}
+		u32 color = (keys & KEY_Y) ? RGBA8(0xFF, 0x00, 0x00, 0xFF) : RGBA8(0x00, 0xC0, 0x00, 0xFF);
+		drawAxes(view, color, cursor.x, cursor.y, traceUndefined);
+		char traceText[64] = "X = ";
+		FormatFixed(traceText + 4, sizeof(traceText) - 4, cursor.x, 5);
+	            mainFont.drawLayout(mainFont.layoutStr(traceLayoutX, traceText), 2, 0, color);
+		if (!traceUndefined) {
+			traceText[0] = 'Y';
+			int length = 4 + FormatFixed(traceText + 4, sizeof(traceText) - 4, cursor.y, 5);
+			if (plots[plotIndex]->type == Plot::T_INTEGRAL && (keys & KEY_Y)) {
+				traceText[length++] = ' ';
+				formatError(traceText + length, sizeof(traceText) - length, traceError);
+			}
+	                mainFont.drawLayout(mainFont.layoutStr(traceLayoutY, traceText), 2, 22, color);
+		}
+		if (traceIntegral) {
+			// From the mark to the cursor
+			char integralText[64] = "Int = ";
+			int length = 6 + FormatFixed(integralText + 6, sizeof(integralText) - 6, integral, 5);
+			integralText[length++] = ' ';
+			formatError(integralText + length, sizeof(integralText) - length, integralError);
+	                mainFont.drawLayout(mainFont.layoutStr(traceLayoutIntegral, integralText), 2, 44, color);
+		}
+		if (traceComplex) {
+			char complexText[64] = "f = ";
+			formatComplex(complexText + 4, sizeof(complexText) - 4, traceRe, traceIm);
+			// A function's goes in place of its Y, which is undefined
+			int line = (plots[plotIndex]->type == Plot::T_COMPLEX) ? 44 : 22;
+	                mainFont.drawLayout(mainFont.layoutStr(traceLayoutComplex, complexText), 2, line, color);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	float cursorX = 200.0f, cursorY = 120.0f;
 	
-	equations[0].push_back(RpnInstruction(&exprX, "x"));
-	equations[0].push_back(RpnInstruction(std::sin, "sin"));
+	for (int i=0; i<4; i++) {
+		plots.push_back(std::unique_ptr<Plot>(new Plot(plotColors[i])));
+	}
+	plots[0]->equation.push_back(RpnInstruction(RpnEnvironment::VAR_X));
+	plots[0]->equation.push_back(RpnInstruction(std::sin, "sin"));
+	
+	// The fonts go first, since setting up the grids lays out the text of the controls
+	sf2d_init();
+	sf2d_set_clear_color(RGBA8(0xE0, 0xE0, 0xE0, 0xFF));
+	
+	romfsInit();
+	BmpFont *fonts[] = { &mainFont, &btnFont };
+	const char *fontNames[] = { "main", "buttons" };
+	if (!BmpFont::loadAtlas("romfs:/fonts.bfa", fonts, fontNames, 2)) {
+		mainFont.load("romfs:/mainfont.bff");
+		btnFont.load("romfs:/buttons.bff");
+	}
+	BmpFont::setBatch(&glyphBatch);
 	
 	ControlGrid<5, 7> cgridMain(45, 48);
 	cgridMain.SetDrawOffset(2, 0);
@@ -121,12 +730,10 @@ int main(int argc, char *argv[])
 	SetUpVarsControlGrid(cgridVars);
 	controlGrids.push_back(&cgridVars);
 	
-	sf2d_init();
-	sf2d_set_clear_color(RGBA8(0xE0, 0xE0, 0xE0, 0xFF));
-	
-	romfsInit();
-	mainFont.load("romfs:/mainfont.bff");
-    btnFont.load("romfs:/buttons.bff");
+	ControlGrid<5, 7> cgridPlots(45, 48);
+	cgridPlots.SetDrawOffset(2, 0);
+	SetUpPlotsControlGrid(cgridPlots);
+	controlGrids.push_back(&cgridPlots);
 	
 	while (aptMainLoop()) {
 		hidScanInput();
@@ -165,8 +772,8 @@ int main(int argc, char *argv[])
 				if (down & KEY_DDOWN) ++plotIndex;
 				
 				if (plotIndex < 0)
-					plotIndex = plotCount - 1;
-				else if (plotIndex >= plotCount)
+					plotIndex = plots.size() - 1;
+				else if (plotIndex >= (int)plots.size())
 					plotIndex = 0;
 				
 				UpdateEquationDisplay();
@@ -178,6 +785,9 @@ int main(int argc, char *argv[])
 				if (down & KEY_DLEFT) moveCursor(cursorX, cursorY, -1.0f, 0.0f);
 				if (down & KEY_DRIGHT) moveCursor(cursorX, cursorY, 1.0f, 0.0f);
 			} else if (!(keys & KEY_TOUCH)) {
+				// Grids only change between touches, but a touch that ended this frame still
+				// has to be released on the grid it started on
+				controlGrids[cgridIndex]->ScreenTouchStatus(false, 0, 0);
 				if (down & KEY_DLEFT) --cgridIndex;
 				if (down & KEY_DRIGHT) ++cgridIndex;
 			
@@ -190,12 +800,28 @@ int main(int argc, char *argv[])
 			}
 		}
 		
+		// A in cursor mode starts a solution curve of an ODE plot at the cursor
+		if ((keys & KEY_X) && (down & KEY_A) && plots[plotIndex]->type == Plot::T_ODE) {
+			Plot &plot = *plots[plotIndex];
+			if (plot.startX.size() >= maxOdeStarts) {
+				plot.startX.erase(plot.startX.begin());
+				plot.startY.erase(plot.startY.begin());
+			}
+			Point<float> start = view.GetGraphCoords(cursorX, cursorY);
+			plot.startX.push_back(start.x);
+			plot.startY.push_back(start.y);
+		}
+		
 		circlePosition circle;
 		hidCircleRead(&circle);
 		
 		if (circle.dx * circle.dx + circle.dy * circle.dy > 20*20) {
 			if (keys & (KEY_X | KEY_Y)) {
 				moveCursor(cursorX, cursorY, 0.05f * circle.dx, -0.05f * circle.dy);
+			} else if (plots[plotIndex]->type == Plot::T_SURFACE) {
+				// Turns the camera instead of panning; L and R still zoom the domain
+				surfaceYaw = std::remainder(surfaceYaw + 0.0002f * circle.dx, 2 * (float)M_PI);
+				surfacePitch = std::max(0.0f, std::min((float)M_PI / 2, surfacePitch - 0.0002f * circle.dy));
 			} else {
 				float rangeX = view.xmax - view.xmin;
 				float rangeY = view.ymax - view.ymin;
@@ -203,73 +829,87 @@ int main(int argc, char *argv[])
 			}
 		}
 		
-		sf2d_start_frame(GFX_TOP, GFX_LEFT);
-		sf2d_draw_rectangle(0, 0, 400, 240, RGBA8(0xFF, 0xFF, 0xFF, 0xFF));
-		drawAxes(view, RGBA8(0x80, 0xFF, 0xFF, 0xFF));
-		
-		for (int i=0; i<plotCount; i++) {
-			drawGraph(equations[i], view, plotColors[i], i == plotIndex);
+		for (int i=0; i<4; i++) {
+			env[RpnEnvironment::VAR_A + i] = varSliders[i]->value;
 		}
+		view.GetColumnX(columnX, 400);
+		samplePlots();
+		updateHeatmaps();
+		updateIteratedMaps();
+		updateSurfaces();
+		renderLayers();
 		
-		if (keys & (KEY_X | KEY_Y)) {
-			Point<float> cursor = view.GetGraphCoords(cursorX, cursorY);
-			if (keys & KEY_Y) {
-				if (keys & KEY_B) {
-					traceUnit = std::pow(10.0f, std::ceil(std::log10((view.xmax - view.xmin) / 400)));
-					cursor.x = std::round(cursor.x / traceUnit) * traceUnit;
-				}
-				exprX = cursor.x;
-				RpnInstruction::Status status = ExecuteRpn(equations[plotIndex], cursor.y);
-				traceUndefined = (status != RpnInstruction::S_OK);
-			} else {
-				traceUndefined = false;
+		sf2d_start_frame(GFX_TOP, GFX_LEFT);
+		sf2d_draw_rectangle(0, 0, 400, 240, RGBA8(0xFF, 0xFF, 0xFF, 0xFF));
+		if (plots[plotIndex]->type == Plot::T_SURFACE) {
+			// The surface gets the whole screen, since the 2D graphs don't share its axes
+			if (plots[plotIndex]->surface) {
+				plots[plotIndex]->surface->Draw(surfaceYaw, surfacePitch, plots[plotIndex]->color);
 			}
-			u32 color = (keys & KEY_Y) ? RGBA8(0xFF, 0x00, 0x00, 0xFF) : RGBA8(0x00, 0xC0, 0x00, 0xFF);
-			drawAxes(view, color, cursor.x, cursor.y, traceUndefined);
-            mainFont.drawStr(ssprintf("X = %.5f", cursor.x), 2, 0, color);
-			if (!traceUndefined)
-                mainFont.drawStr(ssprintf("Y = %.5f", cursor.y), 2, 22, color);
+		} else {
+			drawGraphScreen(cursorX, cursorY);
 		}
         if (altMode) btnFont.align(ALIGN_LEFT).drawStr("ALT", 2, 225, RGBA8(0x48, 0x67, 0x4E, 0xFF));
+		glyphBatch.Flush();
 		sf2d_end_frame();
 		
 		sf2d_start_frame(GFX_BOTTOM, GFX_LEFT);
 		controlGrids[cgridIndex]->ScreenTouchStatus(keys & KEY_TOUCH, touch.px, touch.py);
 		controlGrids[cgridIndex]->Draw();
+		glyphBatch.Flush();
 		sf2d_end_frame();
 		
 		sf2d_swapbuffers();
 	}
 	
+	Heatmap::StopWorker();
 	romfsExit();
 	sf2d_fini();
 	
 	return 0;
 }
 
+// Text of the last token of the current equation: the number being typed, if any. Valid until
+// the next call.
+const char *LastTokenText()
+{
+	static std::string entry;
+	if (numpad.EntryInProgress()) {
+		numpad.GetEntryString(entry);
+		return entry.c_str();
+	}
+	
+	static char text[32];
+	plots[plotIndex]->equation.back().Format(text, sizeof(text));
+	return text;
+}
+
+// Rebuilds the whole equation display, and the controls showing the current plot's settings;
+// edits of the last token go through equDisp directly
 void UpdateEquationDisplay()
 {
-	std::ostringstream ss;
-	auto count = equations[plotIndex].size();
-	if (numpad.EntryInProgress()) --count;
+	if (btnPlotType != nullptr) {
+		btnPlotType->SetText(plotTypeName(plots[plotIndex]->type));
+	}
+	
+	equDisp->Clear();
 	
-	for (decltype(count) i=0; i<count; i++) {
-		ss << equations[plotIndex][i] << ' ';
+	char text[32];
+	for (const RpnInstruction &inst : plots[plotIndex]->equation) {
+		inst.Format(text, sizeof(text));
+		equDisp->Push(text);
 	}
 	
 	if (numpad.EntryInProgress()) {
-		std::string entry;
-		numpad.GetEntryString(entry);
-		ss << entry;
+		equDisp->ReplaceLast(LastTokenText());
 	}
 	
-	equDisp->SetText(ss.str());
-	equDisp->SetTextColor(plotColors[plotIndex]);
+	equDisp->SetTextColor(plots[plotIndex]->color);
 }
 
 void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 {
-	equDisp = new TextDisplay();
+	equDisp = new EquationDisplay();
 	cgrid.cells[0][0].content = equDisp;
 	UpdateEquationDisplay();
 	
@@ -283,10 +923,10 @@ void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 	
 	const char *btnTextAlt[5][7] = {
 		{nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr},
-		{nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr},
-		{nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     nullptr,     "log"},
-		{nullptr,     nullptr,     nullptr,     nullptr,     "asin",      "acos",      "atan"},
-		{nullptr,     nullptr,     nullptr,     nullptr,     "dup",       "def. view", nullptr}
+		{nullptr,     nullptr,     nullptr,     "[",         "<",         ">",         "?"},
+		{nullptr,     nullptr,     nullptr,     "]prod",     "min",       "max",       "log"},
+		{nullptr,     nullptr,     nullptr,     "k",         "asin",      "acos",      "atan"},
+		{nullptr,     nullptr,     nullptr,     "]sum",      "dup",       "def. view", nullptr}
 	};
 	
 	constexpr Button::ColorPreset C_BLUE = Button::ColorPreset::C_BLUE;
@@ -307,15 +947,15 @@ void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_DIVIDE, RpnInstruction::OP_POWER, RpnInstruction::OP_MODULO, RpnInstruction(std::abs, "abs") },
 		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_MULTIPLY, RpnInstruction(std::sqrt, "sqrt", ~RpnInstruction::D_NEGATIVE), RpnInstruction(std::exp, "exp"), RpnInstruction(std::log, "ln", RpnInstruction::D_POSITIVE) },
 		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_SUBTRACT, RpnInstruction(std::sin, "sin"), RpnInstruction(std::cos, "cos"), RpnInstruction(std::tan, "tan") },
-		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_ADD, RpnInstruction(&exprX, "x"), RpnInstruction::OP_NULL, RpnInstruction::OP_NULL }
+		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_ADD, RpnInstruction(RpnEnvironment::VAR_X), RpnInstruction::OP_NULL, RpnInstruction::OP_NULL }
 	};
 	
 	const RpnInstruction btnInstructionsAlt[5][7] = {
 		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL },
-		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL },
-		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction(std::log10, "log", RpnInstruction::D_POSITIVE) },
-		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction(std::asin, "asin"), RpnInstruction(std::acos, "acos"), RpnInstruction(std::atan, "atan") },
-		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_DUP, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL }
+		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_LOOP, RpnInstruction::OP_LESS, RpnInstruction::OP_GREATER, RpnInstruction::OP_SELECT },
+		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_PRODUCT, RpnInstruction::OP_MIN, RpnInstruction::OP_MAX, RpnInstruction(std::log10, "log", RpnInstruction::D_POSITIVE) },
+		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction(RpnEnvironment::VAR_K), RpnInstruction(std::asin, "asin"), RpnInstruction(std::acos, "acos"), RpnInstruction(std::atan, "atan") },
+		{RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL, RpnInstruction::OP_SUM, RpnInstruction::OP_DUP, RpnInstruction::OP_NULL, RpnInstruction::OP_NULL }
 	};
 	
 	const char *numpadKeys[] = { "789", "456", "123", "0.-" };
@@ -333,9 +973,10 @@ void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 						if (altMode) {
 							view = ViewWindow(-5.0f, 5.0f, -3.0f, 3.0f);
 						} else {
-							equations[plotIndex].clear();
+							plots[plotIndex]->equation.clear();
+							plots[plotIndex]->Edited();
 							numpad.Reset();
-							UpdateEquationDisplay();
+							equDisp->Clear();
 						}
 					});
 				} else if ((r > 0 && c < 3) || (r == 0 && c == 6)) {
@@ -348,22 +989,25 @@ void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 					}
 					btn->SetAction([key](Button&) {
 						if (key == '\b' && !numpad.EntryInProgress()) {
-							if (equations[plotIndex].size() > 0) {
-								equations[plotIndex].pop_back();
+							if (plots[plotIndex]->equation.size() > 0) {
+								plots[plotIndex]->equation.pop_back();
+								equDisp->Pop();
 							}
 						} else {
 							const RpnInstruction *lastInst = nullptr;
-							if (equations[plotIndex].size() > 0) {
-								lastInst = &equations[plotIndex].back();
+							if (plots[plotIndex]->equation.size() > 0) {
+								lastInst = &plots[plotIndex]->equation.back();
 							}
 							NumpadController::Reply reply = numpad.KeyPressed(key, lastInst);
 							if (reply.replaceLast) {
-								equations[plotIndex].back() = reply.inst;
+								plots[plotIndex]->equation.back() = reply.inst;
+								equDisp->ReplaceLast(LastTokenText());
 							} else {
-								equations[plotIndex].push_back(reply.inst);
+								plots[plotIndex]->equation.push_back(reply.inst);
+								equDisp->Push(LastTokenText());
 							}
 						}
-						UpdateEquationDisplay();
+						plots[plotIndex]->Edited();
 					});
 				} else if (opcode != RpnInstruction::OP_NULL) {
 					//one of the buttons that adds an RPN instruction
@@ -389,23 +1033,45 @@ void SetUpMainControlGrid(ControlGrid<5, 7> &cgrid)
 void SetUpVarsControlGrid(ControlGrid<5, 7> &cgrid)
 {
 	cgrid.cells[0][0].content = equDisp;
-	cgrid.cells[0][0].colSpan = 6;
+	cgrid.cells[0][0].colSpan = 5;
 	cgrid.cells[0][6].content = btnBackspace;
 	
+	// Family mode: tap to pick the slider to sweep (or none), alt to pick how many curves
+	Button *famBtn = new Button("fam", Button::C_ORANGE);
+	famBtn->SetText("N=16", true);
+	famBtn->SetAction([](Button &btn) {
+		if (altMode) {
+			familyCount = (familyCount >= 32) ? 4 : familyCount * 2;
+			btn.SetText(ssprintf("N=%d", familyCount), true);
+		} else {
+			if (familySlot < 0) {
+				familySlot = RpnEnvironment::VAR_A;
+			} else if (familySlot == RpnEnvironment::VAR_D) {
+				familySlot = -1;
+			} else {
+				++familySlot;
+			}
+			btn.SetText((familySlot < 0) ? std::string("fam") : "fam " + std::string(RpnEnvironment::SlotName(familySlot)), false);
+		}
+	});
+	cgrid.cells[0][5].content = famBtn;
+	
 	for (int i=0; i<4; i++) {
 		Slider *slider = new Slider();
 		slider->value = 0.5f;
+		varSliders[i] = slider;
 		cgrid.cells[i+1][1] = slider;
 		cgrid.cells[i+1][1].colSpan = 5;
 		
 		char varName[2] = {(char)('a' + i), '\0'};
 		Button *btn = new Button(varName, Button::C_BLUE);
 		btn->SetText(">|", true);
-		btn->SetAction([slider, varName](Button&) {
+		RpnEnvironment::Slot slot = (RpnEnvironment::Slot)(RpnEnvironment::VAR_A + i);
+		btn->SetAction([slider, slot](Button&) {
 			if (altMode) {
 				slider->SetMinimum(slider->value);
 			} else {
-				addInstruction(RpnInstruction(&slider->value, varName));
+				addInstruction(RpnInstruction(slot));
 			}
 		});
 		cgrid.cells[i+1][0].content = btn;
@@ -424,3 +1090,76 @@ void SetUpVarsControlGrid(ControlGrid<5, 7> &cgrid)
 		cgrid.cells[i+1][6].content = btn;
 	}
 }
+
+void SetUpPlotsControlGrid(ControlGrid<5, 7> &cgrid)
+{
+	cgrid.cells[0][0].content = equDisp;
+	cgrid.cells[0][0].colSpan = 6;
+	cgrid.cells[0][6].content = btnBackspace;
+	
+	Button *btn = new Button("new", Button::C_ORANGE);
+	btn->SetAction([](Button&) {
+		plots.push_back(std::unique_ptr<Plot>(new Plot(plotColors[plots.size() % 8])));
+		plotIndex = plots.size() - 1;
+		numpad.Reset();
+		UpdateEquationDisplay();
+	});
+	cgrid.cells[1][0].content = btn;
+	
+	btn = new Button("del", Button::C_ORANGE);
+	btn->SetAction([](Button&) {
+		if (plots.size() > 1) {
+			deletePlot(plotIndex);
+			numpad.Reset();
+			UpdateEquationDisplay();
+		}
+	});
+	cgrid.cells[1][1].content = btn;
+	
+	btnPlotType = new Button(plotTypeName(Plot::T_FUNCTION), Button::C_ORANGE);
+	btnPlotType->SetAction([](Button &btn) {
+		Plot &plot = *plots[plotIndex];
+		plot.type = (Plot::Type)((plot.type + 1) % 10);
+		plot.Edited();
+		btn.SetText(plotTypeName(plot.type));
+	});
+	cgrid.cells[1][2].content = btnPlotType;
+	
+	btn = new Button("t", Button::C_BLUE);
+	btn->SetAction([](Button&) {
+		addInstruction(RpnInstruction(RpnEnvironment::VAR_T));
+	});
+	cgrid.cells[1][3].content = btn;
+	
+	btn = new Button("y", Button::C_BLUE);
+	btn->SetAction([](Button&) {
+		addInstruction(RpnInstruction(RpnEnvironment::VAR_Y));
+	});
+	cgrid.cells[1][4].content = btn;
+	
+	btn = new Button("cont", Button::C_ORANGE);
+	btn->SetAction([](Button &btn) {
+		showContours = !showContours;
+		btn.SetText(showContours ? "cont" : "plain");
+	});
+	cgrid.cells[1][5].content = btn;
+	
+	// Removes the solution curves of an ODE plot; X+A adds them
+	btn = new Button("clr", Button::C_ORANGE);
+	btn->SetAction([](Button&) {
+		plots[plotIndex]->startX.clear();
+		plots[plotIndex]->startY.clear();
+	});
+	cgrid.cells[1][6].content = btn;
+	
+	// References to the other plots' values at the same x
+	for (int i=0; i<21; i++) {
+		btn = new Button(ssprintf("y%d", i + 1), Button::C_GREEN);
+		btn->SetAction([i](Button&) {
+			if (i < (int)plots.size()) {
+				addInstruction(RpnInstruction(RpnInstruction::OP_PUSHPLOT, i));
+			}
+		});
+		cgrid.cells[2 + i / 7][i % 7].content = btn;
+	}
+}
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Packs several .bff bitmap fonts into one .bfa font atlas.
+
+Usage: packfonts.py [--format=FORMAT] OUTPUT NAME=FONT.bff [NAME=FONT.bff ...]
+
+All fonts end up in a single texture, so text from any of them can be drawn
+without switching textures. Only 8-bit (alpha-only) fonts are supported.
+
+FORMAT is the texture format to store: a4 (default), a8, la4 or rgba8. The
+fonts are tinted with the blend color when drawn, so nothing but alpha is
+needed; a4 takes an eighth of the memory of rgba8.
+
+.bfa layout (all integers little-endian):
+    char[3]  magic 'BFA'
+    u8       version (2)
+    u32      texture width, texture height (powers of two)
+    u8       texture format (sf2d_texfmt: 0 = RGBA8, 8 = A8, 9 = IA4, 11 = A4)
+    u8       font count
+    per font:
+        char[16] name (NUL-padded)
+        u32      origin x, origin y (top-left corner of the font within the atlas)
+        u32      image width, image height, cell width, cell height
+        u8       base character
+        u8[256]  character widths
+    u32      texture data size in bytes
+    texture data, in the GPU's tiled layout, ready to be copied into the texture
+
+The GPU layout stores the image bottom row first, in 8x8 tiles ordered left to
+right, with the texels in each tile in Morton (Z) order. RGBA8 texels are
+stored as A, B, G, R bytes; IA4 texels as one byte with intensity in the high
+nibble; A4 texels two per byte, the first one in the low nibble.
+"""
+
+import struct
+import sys
+
+BFF_HEADER = struct.Struct('<2sIIIIBB')
+FONT_ENTRY = struct.Struct('<16sIIIIIIB256s')
+TEXFMT_RGBA8 = 0
+TEXFMT_A8 = 8
+TEXFMT_IA4 = 9
+TEXFMT_A4 = 11
+
+
+def to4(a):
+    return (a * 15 + 127) // 255
+
+
+def encode_rgba8(alpha):
+    return b''.join(bytes((a, 0xFF, 0xFF, 0xFF)) for a in alpha)
+
+
+def encode_a8(alpha):
+    return bytes(alpha)
+
+
+def encode_ia4(alpha):
+    return bytes(0xF0 | to4(a) for a in alpha)
+
+
+def encode_a4(alpha):
+    return bytes(to4(alpha[i]) | (to4(alpha[i + 1]) << 4) for i in range(0, len(alpha), 2))
+
+
+FORMATS = {
+    'rgba8': (TEXFMT_RGBA8, encode_rgba8),
+    'a8': (TEXFMT_A8, encode_a8),
+    'la4': (TEXFMT_IA4, encode_ia4),
+    'a4': (TEXFMT_A4, encode_a4),
+}
+
+
+def next_pow2(n):
+    p = 8
+    while p < n:
+        p *= 2
+    return p
+
+
+def morton(x, y):
+    result = 0
+    for bit in range(3):
+        result |= ((x >> bit) & 1) << (2 * bit)
+        result |= ((y >> bit) & 1) << (2 * bit + 1)
+    return result
+
+
+def tile(texels, width, height):
+    """Reorders a row-major, top-down list of texels into the GPU's tiled layout."""
+    out = [None] * (width * height)
+    for y in range(height):
+        gy = height - 1 - y
+        row = texels[y * width:(y + 1) * width]
+        for x in range(width):
+            out[((gy >> 3) * (width >> 3) + (x >> 3)) * 64 + morton(x & 7, gy & 7)] = row[x]
+    return out
+
+
+def read_bff(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, width, height, cell_w, cell_h, bits, base = BFF_HEADER.unpack_from(data)
+    if magic != b'\xBF\xF2':
+        sys.exit('%s: not a BFF font' % path)
+    if bits != 8:
+        sys.exit('%s: only 8-bit fonts can be packed (this one is %d-bit)' % (path, bits))
+    offset = BFF_HEADER.size
+    widths = data[offset:offset + 256]
+    offset += 256
+    pixels = data[offset:offset + width * height]
+    if len(pixels) != width * height:
+        sys.exit('%s: truncated image data' % path)
+    return {
+        'width': width, 'height': height,
+        'cell_w': cell_w, 'cell_h': cell_h,
+        'base': base, 'widths': widths, 'pixels': pixels,
+    }
+
+
+def main(argv):
+    args = argv[1:]
+    format_name = 'a4'
+    if args and args[0].startswith('--format='):
+        format_name = args.pop(0)[len('--format='):]
+    if format_name not in FORMATS or len(args) < 2:
+        sys.exit(__doc__)
+    texfmt, encode = FORMATS[format_name]
+
+    fonts = []
+    for arg in args[1:]:
+        name, sep, path = arg.partition('=')
+        if not sep or not name or len(name) > 15:
+            sys.exit('bad font argument: %s' % arg)
+        font = read_bff(path)
+        font['name'] = name
+        fonts.append(font)
+
+    # Stack the fonts vertically, tallest first.
+    atlas_w = next_pow2(max(font['width'] for font in fonts))
+    used_h = 0
+    for font in sorted(fonts, key=lambda font: -font['height']):
+        font['x'] = 0
+        font['y'] = used_h
+        used_h += font['height']
+    atlas_h = next_pow2(used_h)
+
+    alpha = bytearray(atlas_w * atlas_h)
+    for font in fonts:
+        w = font['width']
+        for row in range(font['height']):
+            dst = (font['y'] + row) * atlas_w + font['x']
+            alpha[dst:dst + w] = font['pixels'][row * w:(row + 1) * w]
+
+    texdata = encode(tile(alpha, atlas_w, atlas_h))
+
+    with open(args[0], 'wb') as f:
+        f.write(b'BFA')
+        f.write(struct.pack('<BIIBB', 2, atlas_w, atlas_h, texfmt, len(fonts)))
+        for font in fonts:
+            f.write(FONT_ENTRY.pack(font['name'].encode('ascii'), font['x'], font['y'],
+                                    font['width'], font['height'], font['cell_w'], font['cell_h'],
+                                    font['base'], bytes(font['widths'])))
+        f.write(struct.pack('<I', len(texdata)))
+        f.write(texdata)
+
+    saved = atlas_w * atlas_h * 4 - len(texdata)
+    print('%s: %dx%d %s, %d bytes (%d bytes less than rgba8)' % (args[0], atlas_w, atlas_h, format_name, len(texdata), saved))
+
+
+if __name__ == '__main__':
+    main(sys.argv)